@@ -0,0 +1,330 @@
+#include "AssetLoader.h"
+#include "GLExtensions.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// Everything loaded through here is colour data
+AssetLoader::AssetLoader() : pending(0), unpackBuffer(0), textureFlags(TextureCache::SRGB) {
+}
+
+std::shared_ptr<TextureCacheImage> AssetLoader::loadImage(const std::string& path, uint32_t flags) {
+
+	std::shared_ptr<TextureCacheImage> image = std::make_shared<TextureCacheImage>();
+	if (!TextureCache::load(path, flags, *image))
+		return nullptr;
+	return image;
+}
+
+void AssetLoader::queueUpload(std::function<void()> upload) {
+	{
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		uploads.push_back(std::move(upload));
+	}
+	uploadReady.notify_one();
+}
+
+GLuint AssetLoader::createPlaceholder(GLenum target) {
+
+	static const unsigned char texel[4] = { 128, 128, 128, 255 };
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(target, texture);
+
+	if (target == GL_TEXTURE_CUBE_MAP) {
+		for (GLenum face = 0; face < 6; face++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	}
+	else {
+		glTexImage2D(target, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	}
+
+	// No mip chain yet, so the placeholder has to sample without one
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glBindTexture(target, 0);
+	return texture;
+}
+
+void AssetLoader::uploadImage(GLenum target, const TextureCacheImage& image, uint32_t levelCount) {
+
+	// Levels sit back to back in the cache, so the whole chain is staged with one copy
+	const TextureCacheHeader& header = image.header();
+	const TextureCacheLevel& last = image.level(levelCount - 1);
+
+	const unsigned char* first = image.pixels(0);
+	GLsizeiptr size = (GLsizeiptr)(last.offset + last.size - image.level(0).offset);
+
+	if (unpackBuffer == 0)
+		glGenBuffers(1, &unpackBuffer);
+
+	// Orphan the previous contents so this upload never waits on the last one
+	// still being copied out, then stage the pixels through a write-only mapping.
+	// glTexImage2D then sources from the buffer and can return before the copy.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+	const void* source = nullptr;
+	void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (staging != nullptr) {
+		memcpy(staging, first, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		source = first;
+	}
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		const TextureCacheLevel& level = image.level(i);
+		const unsigned char* data = (const unsigned char*)source + (level.offset - image.level(0).offset);
+		if (TextureCache::isCompressed(header))
+			glCompressedTexImage2D(target, i, header.internalFormat, level.width, level.height, 0, level.size, data);
+		else
+			glTexImage2D(target, i, header.internalFormat, level.width, level.height, 0, header.format, header.type, data);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void AssetLoader::recordTexture(const std::string& path, const TextureCacheImage& image, uint32_t levelCount) {
+
+	TextureReport report;
+	report.path = path;
+	report.internalFormat = image.header().internalFormat;
+	report.uncompressedBytes = 0;
+	report.uploadedBytes = 0;
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		const TextureCacheLevel& level = image.level(i);
+		report.uncompressedBytes += (size_t)level.width * level.height * 4;
+		report.uploadedBytes += level.size;
+	}
+
+	textureReports.push_back(report);
+}
+
+GLuint AssetLoader::loadTexture(const std::string& path) {
+
+	GLuint texture = createPlaceholder(GL_TEXTURE_2D);
+	uint32_t flags = textureFlags;
+	pending++;
+
+	workers.submit([this, texture, path, flags] {
+
+		std::shared_ptr<TextureCacheImage> image = loadImage(path, flags);
+
+		queueUpload([this, texture, path, image] {
+
+			if (image == nullptr) {
+				std::cout << "AssetLoader: failed to load texture " << path << std::endl;
+				return;
+			}
+
+			uint32_t levelCount = image->header().levelCount;
+
+			glBindTexture(GL_TEXTURE_2D, texture);
+			uploadImage(GL_TEXTURE_2D, *image, levelCount);
+			recordTexture(path, *image, levelCount);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+			glBindTexture(GL_TEXTURE_2D, 0);
+		});
+	});
+
+	return texture;
+}
+
+GLuint AssetLoader::loadCubeMapTexture(const std::string& directory, const std::string& prefix, const std::string& extension, GLint format, GLint minFilter, GLint magFilter, GLfloat anisotropy, GLint wrapS, GLint wrapT, GLint wrapR, bool generateMipmaps) {
+
+	// In GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+	static const char* const faceNames[6] = { "_positive_x", "_negative_x", "_positive_y", "_negative_y", "_positive_z", "_negative_z" };
+
+	struct CubeMapLoad {
+		std::shared_ptr<TextureCacheImage> faces[6];
+		std::atomic<int> remaining;
+	};
+
+	GLuint texture = createPlaceholder(GL_TEXTURE_CUBE_MAP);
+	uint32_t flags = textureFlags;
+	pending++;
+
+	std::shared_ptr<CubeMapLoad> load = std::make_shared<CubeMapLoad>();
+	load->remaining = 6;
+
+	for (int face = 0; face < 6; face++) {
+
+		std::string path = directory + prefix + faceNames[face] + extension;
+
+		workers.submit([=] {
+
+			load->faces[face] = loadImage(path, flags);
+
+			// The last face to finish hands the whole set over for upload
+			if (--load->remaining != 0)
+				return;
+
+			queueUpload([=] {
+
+				for (int i = 0; i < 6; i++) {
+					if (load->faces[i] == nullptr) {
+						std::cout << "AssetLoader: failed to load cube map face " << directory + prefix + faceNames[i] + extension << std::endl;
+						return;
+					}
+				}
+
+				// Without mipmaps only the top level goes up
+				uint32_t levelCount = generateMipmaps ? load->faces[0]->header().levelCount : 1;
+
+				glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+				for (int i = 0; i < 6; i++) {
+					uploadImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, *load->faces[i], levelCount);
+					recordTexture(directory + prefix + faceNames[i] + extension, *load->faces[i], levelCount);
+				}
+
+				glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minFilter);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, magFilter);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, wrapS);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, wrapT);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, wrapR);
+				glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+				glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+				glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+			});
+		});
+	}
+
+	return texture;
+}
+
+void AssetLoader::loadModel(StaticModel& model, const std::string& path) {
+
+	StaticModel* target = &model;
+	pending++;
+
+	workers.submit([this, target, path] {
+
+		// Cache lookup, mapping and (on a miss) the Assimp import all happen here
+		std::shared_ptr<MeshCacheImage> image = std::make_shared<MeshCacheImage>();
+		bool loaded = MeshCache::load(path, StaticModel::IMPORT_FLAGS, StaticModel::CACHE_OPTIONS, *image);
+
+		queueUpload([this, target, path, image, loaded] {
+
+			if (!loaded) {
+				std::cout << "AssetLoader: failed to load model " << path << std::endl;
+				return;
+			}
+
+			// Material textures go through the same queue and arrive later
+			target->upload(*image, path, [this](const std::string& texturePath) { return loadTexture(texturePath); });
+		});
+	});
+}
+
+bool AssetLoader::setTextureCompression(bool enabled) {
+
+	if (!enabled) {
+		textureFlags &= ~TextureCache::COMPRESS;
+		return true;
+	}
+
+	if (hasGLExtension("GL_EXT_texture_compression_s3tc")) {
+		textureFlags |= TextureCache::COMPRESS;
+		return true;
+	}
+
+	std::cout << "AssetLoader: S3TC not supported, textures stay uncompressed" << std::endl;
+	return false;
+}
+
+void AssetLoader::writeTextureReport(std::ostream& out) const {
+
+	size_t totalUncompressed = 0;
+	size_t totalUploaded = 0;
+
+	out << "Texture memory (uploaded / as RGBA8, saved):" << std::endl;
+
+	for (const TextureReport& report : textureReports) {
+
+		const char* format = "RGBA8";
+		if (report.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+			format = "BC1";
+		else if (report.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+			format = "BC3";
+		else if (report.internalFormat == GL_COMPRESSED_RG_RGTC2)
+			format = "BC5";
+
+		out << "  " << std::left << std::setw(6) << format << std::right
+			<< std::setw(10) << report.uploadedBytes << " / " << std::setw(10) << report.uncompressedBytes
+			<< ", saved " << std::setw(10) << report.uncompressedBytes - report.uploadedBytes << "  " << report.path << std::endl;
+
+		totalUncompressed += report.uncompressedBytes;
+		totalUploaded += report.uploadedBytes;
+	}
+
+	out << "  total " << totalUploaded << " / " << totalUncompressed << ", saved " << totalUncompressed - totalUploaded << std::endl;
+}
+
+unsigned AssetLoader::pump(double budgetMs) {
+
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	unsigned count = 0;
+
+	while (true) {
+
+		std::function<void()> upload;
+		{
+			std::lock_guard<std::mutex> lock(uploadMutex);
+			if (uploads.empty())
+				break;
+			upload = std::move(uploads.front());
+			uploads.pop_front();
+		}
+
+		upload();
+		pending--;
+		count++;
+
+		if (std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= budgetMs)
+			break;
+	}
+
+	return count;
+}
+
+void AssetLoader::flush() {
+
+	while (pending.load() != 0) {
+
+		pump(1e9);
+
+		std::unique_lock<std::mutex> lock(uploadMutex);
+		uploadReady.wait(lock, [this] { return !uploads.empty() || pending.load() == 0; });
+	}
+}
+
+void AssetLoader::release() {
+
+	workers.shutdown();
+	{
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		uploads.clear();
+	}
+	pending = 0;
+
+	if (unpackBuffer != 0) {
+		glDeleteBuffers(1, &unpackBuffer);
+		unpackBuffer = 0;
+	}
+}
@@ -0,0 +1,116 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include "StaticModel.h"
+#include "TextureCache.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Asynchronous counterpart to TextureLoader and StaticModel(path).
+//
+// Every load call returns straight away. Textures come back as a valid name
+// holding a 1x1 placeholder texel; models stay empty and draw nothing. Cache
+// lookups (and, on a miss, image decode or mesh import) run on a worker pool, and the finished
+// data is queued for the context thread, which uploads it from pump() under a
+// per-frame time budget. Texture names never change, so anything that already
+// holds one picks up the real image as soon as it lands.
+//
+// Load calls and pump() must be made on the thread that owns the GL context.
+class AssetLoader {
+
+public:
+
+	// One uploaded texture (or cube map face) and what it costs in video memory
+	struct TextureReport {
+		std::string path;
+		GLenum internalFormat;
+		size_t uncompressedBytes;	// The same levels as RGBA8
+		size_t uploadedBytes;
+	};
+
+private:
+
+	WorkerPool workers;
+
+	std::mutex uploadMutex;
+	std::condition_variable uploadReady;
+	std::deque<std::function<void()>> uploads;	// Run on the context thread
+
+	std::atomic<unsigned> pending;	// Assets requested but not yet uploaded
+
+	GLuint unpackBuffer;	// Pixel unpack buffer that texture uploads are staged through
+
+	uint32_t textureFlags;	// TextureCache flags for new texture loads
+
+	std::vector<TextureReport> textureReports;
+
+	void queueUpload(std::function<void()> upload);
+
+	GLuint createPlaceholder(GLenum target);
+
+	// Uploads the first levelCount levels of a cached mip chain to the bound texture
+	void uploadImage(GLenum target, const TextureCacheImage& image, uint32_t levelCount);
+	void recordTexture(const std::string& path, const TextureCacheImage& image, uint32_t levelCount);
+
+	// Returns null if the texture could not be loaded
+	static std::shared_ptr<TextureCacheImage> loadImage(const std::string& path, uint32_t flags);
+
+public:
+
+	// Upload time allowed per frame when the caller has no better figure
+	static constexpr double DEFAULT_BUDGET_MS = 2.0;
+
+	AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// Same result as TextureLoader::loadTexture once the upload has run, except that
+	// the mip chain comes from the texture cache rather than glGenerateMipmap
+	GLuint loadTexture(const std::string& path);
+
+	// Same arguments and face naming as TextureLoader::loadCubeMapTexture;
+	// the six faces load in parallel and upload together. Faces take whatever
+	// format the texture cache produces (BC1/BC3 once setTextureCompression is
+	// on, RGBA8 otherwise), so format is accepted but ignored either way.
+	GLuint loadCubeMapTexture(const std::string& directory, const std::string& prefix, const std::string& extension, GLint format, GLint minFilter, GLint magFilter, GLfloat anisotropy, GLint wrapS, GLint wrapT, GLint wrapR, bool generateMipmaps);
+
+	// The model must outlive the loader, or at least its release()
+	void loadModel(StaticModel& model, const std::string& path);
+
+	// Opt-in BC1/BC3 storage for textures loaded from now on. Encoding happens
+	// once, when the texture cache is built. Returns false (and stays
+	// uncompressed) if the driver lacks EXT_texture_compression_s3tc.
+	bool setTextureCompression(bool enabled);
+
+	// Per-texture video memory against uncompressed RGBA8, with a total
+	void writeTextureReport(std::ostream& out) const;
+
+	const std::vector<TextureReport>& getTextureReports() const {
+		return textureReports;
+	}
+
+	// Runs queued uploads until the budget is spent; at least one runs per call
+	// so progress is guaranteed. Returns the number of uploads performed.
+	unsigned pump(double budgetMs = DEFAULT_BUDGET_MS);
+
+	// Blocks until every requested asset has been uploaded
+	void flush();
+
+	unsigned getPendingCount() const {
+		return pending.load();
+	}
+
+	// Stops the workers and drops anything not yet uploaded; placeholders stay valid
+	void release();
+};
+
+#endif
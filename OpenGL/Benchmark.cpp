@@ -0,0 +1,237 @@
+#include "Benchmark.h"
+#include "FrameStats.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+void CameraPath::addKeyframe(float time, glm::vec3 eye, glm::vec3 target) {
+	keyframes.push_back({ time, eye, target });
+}
+
+static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+void CameraPath::sample(float time, glm::vec3& eye, glm::vec3& target) const {
+
+	if (keyframes.size() == 1 || time <= keyframes.front().time) {
+		eye = keyframes.front().eye;
+		target = keyframes.front().target;
+		return;
+	}
+	if (time >= keyframes.back().time) {
+		eye = keyframes.back().eye;
+		target = keyframes.back().target;
+		return;
+	}
+
+	size_t next = 1;
+	while (keyframes[next].time < time)
+		next++;
+
+	size_t current = next - 1;
+	const CameraKeyframe& k0 = keyframes[current > 0 ? current - 1 : current];
+	const CameraKeyframe& k1 = keyframes[current];
+	const CameraKeyframe& k2 = keyframes[next];
+	const CameraKeyframe& k3 = keyframes[std::min(next + 1, keyframes.size() - 1)];
+
+	float t = (time - k1.time) / (k2.time - k1.time);
+	eye = catmullRom(k0.eye, k1.eye, k2.eye, k3.eye, t);
+	target = catmullRom(k0.target, k1.target, k2.target, k3.target, t);
+}
+
+CameraPath CameraPath::artemisFlythrough() {
+	CameraPath path;
+	path.addKeyframe(0.0f, glm::vec3(0.0, 5.0, 12.0), glm::vec3(0.0, 2.0, 0.0));
+	path.addKeyframe(4.0f, glm::vec3(15.0, 8.0, 0.0), glm::vec3(0.0, 2.0, 0.0));
+	path.addKeyframe(8.0f, glm::vec3(0.0, 12.0, -15.0), glm::vec3(0.0, 4.0, 0.0));
+	path.addKeyframe(12.0f, glm::vec3(-15.0, 6.0, 0.0), glm::vec3(0.0, 4.0, 0.0));
+	path.addKeyframe(16.0f, glm::vec3(-3.0, 3.0, 4.0), glm::vec3(0.0, 6.0, 0.0));
+	path.addKeyframe(20.0f, glm::vec3(0.0, 5.0, 12.0), glm::vec3(0.0, 2.0, 0.0));
+	return path;
+}
+
+Benchmark::Benchmark(const CameraPath& pathIn, float frameStepIn, int warmupFramesIn)
+	: path(pathIn), frameStep(frameStepIn), warmupFrames(warmupFramesIn) {}
+
+void Benchmark::run(const glm::mat4& projection, RenderFunction render) {
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	GLuint queries[FRAMES_IN_FLIGHT];
+	GLsync fences[FRAMES_IN_FLIGHT] = {};
+	glGenQueries(FRAMES_IN_FLIGHT, queries);
+
+	int pathFrames = (int)std::ceil(path.getDuration() / frameStep) + 1;
+	int totalFrames = warmupFrames + pathFrames;
+
+	cpuFrameMs.clear();
+	gpuFrameMs.clear();
+	drawCalls.clear();
+	triangles.clear();
+	culledObjects.clear();
+	culledTriangles.clear();
+	occludedObjects.clear();
+	occlusionMs.clear();
+	programSwitches.clear();
+	textureSwitches.clear();
+	vertexArraySwitches.clear();
+	unsortedProgramSwitches.clear();
+	unsortedTextureSwitches.clear();
+	unsortedVertexArraySwitches.clear();
+	stateCallsIssued.clear();
+	stateCallsElided.clear();
+
+	for (int frame = 0; frame < totalFrames + FRAMES_IN_FLIGHT; frame++) {
+
+		int slot = frame % FRAMES_IN_FLIGHT;
+
+		// Collect the frame that used this slot FRAMES_IN_FLIGHT frames ago
+		if (fences[slot] != 0) {
+			glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fences[slot]);
+			fences[slot] = 0;
+
+			int finishedFrame = frame - FRAMES_IN_FLIGHT;
+			if (finishedFrame >= warmupFrames) {
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+				gpuFrameMs.push_back(elapsed / 1.0e6);
+			}
+		}
+
+		if (frame >= totalFrames)
+			continue;
+
+		// Warm-up frames hold the first keyframe so caches and drivers settle
+		float time = std::max(0, frame - warmupFrames) * frameStep;
+		glm::vec3 eye, target;
+		path.sample(time, eye, target);
+		glm::mat4 view = glm::lookAt(eye, target, glm::vec3(0.0, 1.0, 0.0));
+
+		frameStats.reset();
+		Clock::time_point start = Clock::now();
+
+		glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+		render(view, projection, eye, glm::normalize(target - eye));
+		glEndQuery(GL_TIME_ELAPSED);
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		double cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		if (frame >= warmupFrames) {
+			cpuFrameMs.push_back(cpuMs);
+			drawCalls.push_back(frameStats.drawCalls);
+			triangles.push_back(frameStats.triangles);
+			culledObjects.push_back(frameStats.culledObjects);
+			culledTriangles.push_back(frameStats.culledTriangles);
+			occludedObjects.push_back(frameStats.occludedObjects);
+			occlusionMs.push_back(frameStats.occlusionMs);
+			programSwitches.push_back(frameStats.programSwitches);
+			textureSwitches.push_back(frameStats.textureSwitches);
+			vertexArraySwitches.push_back(frameStats.vertexArraySwitches);
+			unsortedProgramSwitches.push_back(frameStats.unsortedProgramSwitches);
+			unsortedTextureSwitches.push_back(frameStats.unsortedTextureSwitches);
+			unsortedVertexArraySwitches.push_back(frameStats.unsortedVertexArraySwitches);
+			stateCallsIssued.push_back(frameStats.stateCallsIssued);
+			stateCallsElided.push_back(frameStats.stateCallsElided);
+		}
+	}
+
+	glDeleteQueries(FRAMES_IN_FLIGHT, queries);
+}
+
+double Benchmark::percentile(std::vector<double> samples, double p) {
+
+	if (samples.empty())
+		return 0.0;
+
+	// Nearest-rank percentile
+	std::sort(samples.begin(), samples.end());
+	size_t rank = (size_t)std::ceil(p / 100.0 * samples.size());
+	return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+void Benchmark::writeSummary(std::ostream& out, const char* name, const std::vector<double>& samples) {
+
+	double sum = 0.0;
+	double maximum = 0.0;
+	for (double sample : samples) {
+		sum += sample;
+		maximum = std::max(maximum, sample);
+	}
+
+	out << "\t\"" << name << "\": {"
+		<< "\"p50\": " << percentile(samples, 50)
+		<< ", \"p95\": " << percentile(samples, 95)
+		<< ", \"p99\": " << percentile(samples, 99)
+		<< ", \"mean\": " << (samples.empty() ? 0.0 : sum / samples.size())
+		<< ", \"max\": " << maximum
+		<< "}";
+}
+
+static std::string jsonString(const GLubyte* text) {
+	std::string escaped;
+	for (const char* c = (const char*)text; c != NULL && *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\')
+			escaped += '\\';
+		escaped += *c;
+	}
+	return "\"" + escaped + "\"";
+}
+
+bool Benchmark::writeReport(const std::string& path) const {
+
+	std::ofstream out(path);
+	if (!out) {
+		std::cout << "Benchmark: cannot write report to " << path << std::endl;
+		return false;
+	}
+
+	out << "{\n";
+	out << "\t\"renderer\": " << jsonString(glGetString(GL_RENDERER)) << ",\n";
+	out << "\t\"version\": " << jsonString(glGetString(GL_VERSION)) << ",\n";
+	out << "\t\"frames\": " << cpuFrameMs.size() << ",\n";
+	out << "\t\"warmupFrames\": " << warmupFrames << ",\n";
+	writeSummary(out, "cpuFrameMs", cpuFrameMs);
+	out << ",\n";
+	writeSummary(out, "gpuFrameMs", gpuFrameMs);
+	out << ",\n";
+	writeSummary(out, "drawCalls", drawCalls);
+	out << ",\n";
+	writeSummary(out, "triangles", triangles);
+	out << ",\n";
+	writeSummary(out, "culledObjects", culledObjects);
+	out << ",\n";
+	writeSummary(out, "culledTriangles", culledTriangles);
+	out << ",\n";
+	writeSummary(out, "occludedObjects", occludedObjects);
+	out << ",\n";
+	writeSummary(out, "occlusionMs", occlusionMs);
+	out << ",\n";
+	writeSummary(out, "programSwitches", programSwitches);
+	out << ",\n";
+	writeSummary(out, "textureSwitches", textureSwitches);
+	out << ",\n";
+	writeSummary(out, "vertexArraySwitches", vertexArraySwitches);
+	out << ",\n";
+	writeSummary(out, "unsortedProgramSwitches", unsortedProgramSwitches);
+	out << ",\n";
+	writeSummary(out, "unsortedTextureSwitches", unsortedTextureSwitches);
+	out << ",\n";
+	writeSummary(out, "unsortedVertexArraySwitches", unsortedVertexArraySwitches);
+	out << ",\n";
+	writeSummary(out, "stateCallsIssued", stateCallsIssued);
+	out << ",\n";
+	writeSummary(out, "stateCallsElided", stateCallsElided);
+	out << "\n}\n";
+
+	std::cout << "Benchmark: " << cpuFrameMs.size() << " frames, CPU p50 " << percentile(cpuFrameMs, 50)
+		<< " ms, GPU p50 " << percentile(gpuFrameMs, 50) << " ms, report written to " << path << std::endl;
+	return true;
+}
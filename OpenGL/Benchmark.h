@@ -0,0 +1,83 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct CameraKeyframe {
+	float time;
+	glm::vec3 eye;
+	glm::vec3 target;
+};
+
+// Scripted camera flight, sampled with Catmull-Rom interpolation between keyframes
+class CameraPath {
+
+private:
+
+	std::vector<CameraKeyframe> keyframes;
+
+public:
+
+	void addKeyframe(float time, glm::vec3 eye, glm::vec3 target);
+	void sample(float time, glm::vec3& eye, glm::vec3& target) const;
+
+	float getDuration() const {
+		return keyframes.empty() ? 0.0f : keyframes.back().time;
+	}
+
+	// Orbit of the pad, a pass along the VAB and a close-up of the SLS on the ML
+	static CameraPath artemisFlythrough();
+};
+
+// Replays a CameraPath at a fixed time step and records per-frame CPU
+// submission time, GPU time (GL_TIME_ELAPSED queries), draw calls, culling,
+// render queue state switches and redundant state calls.
+// Frames are rendered as fast as possible; at most FRAMES_IN_FLIGHT frames
+// are queued ahead of the GPU so CPU numbers reflect sustained throughput.
+class Benchmark {
+
+public:
+
+	typedef std::function<void(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eyePos, const glm::vec3& lookDirection)> RenderFunction;
+
+private:
+
+	static const int FRAMES_IN_FLIGHT = 3;
+
+	CameraPath path;
+	float frameStep;
+	int warmupFrames;
+
+	std::vector<double> cpuFrameMs;
+	std::vector<double> gpuFrameMs;
+	std::vector<double> drawCalls;
+	std::vector<double> triangles;
+	std::vector<double> culledObjects;
+	std::vector<double> culledTriangles;
+	std::vector<double> occludedObjects;
+	std::vector<double> occlusionMs;
+	std::vector<double> programSwitches;
+	std::vector<double> textureSwitches;
+	std::vector<double> vertexArraySwitches;
+	std::vector<double> unsortedProgramSwitches;
+	std::vector<double> unsortedTextureSwitches;
+	std::vector<double> unsortedVertexArraySwitches;
+	std::vector<double> stateCallsIssued;
+	std::vector<double> stateCallsElided;
+
+	static double percentile(std::vector<double> samples, double p);
+	static void writeSummary(std::ostream& out, const char* name, const std::vector<double>& samples);
+
+public:
+
+	Benchmark(const CameraPath& pathIn, float frameStepIn = 1.0f / 60.0f, int warmupFramesIn = 30);
+
+	void run(const glm::mat4& projection, RenderFunction render);
+	bool writeReport(const std::string& path) const;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "BlockEncoder.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCKENCODER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	// Copies the 4x4 block at (blockX, blockY) into 16 consecutive RGBA texels
+	void gatherBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* block) {
+		for (uint32_t y = 0; y < 4; y++) {
+			uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++) {
+				uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+				memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+			}
+		}
+	}
+
+	uint16_t to565(const uint8_t* colour) {
+		return (uint16_t)(((colour[0] >> 3) << 11) | ((colour[1] >> 2) << 5) | (colour[2] >> 3));
+	}
+
+	// Back to 8 bits per channel, as the decoder will see it; alpha left at 0
+	uint32_t from565(uint16_t colour) {
+		uint32_t r = (colour >> 11) & 31;
+		uint32_t g = (colour >> 5) & 63;
+		uint32_t b = colour & 31;
+		r = (r << 3) | (r >> 2);
+		g = (g << 2) | (g >> 4);
+		b = (b << 3) | (b >> 2);
+		return r | (g << 8) | (b << 16);
+	}
+
+	uint32_t blend(uint32_t a, uint32_t b, int weightA, int weightB) {
+		uint32_t result = 0;
+		for (int shift = 0; shift < 24; shift += 8)
+			result |= ((((a >> shift) & 0xFF) * weightA + ((b >> shift) & 0xFF) * weightB) / 3) << shift;
+		return result;
+	}
+
+	void boundingBox(const uint8_t* block, uint8_t* minColour, uint8_t* maxColour) {
+#ifdef BLOCKENCODER_SSE2
+		__m128i low = _mm_loadu_si128((const __m128i*)block);
+		__m128i high = low;
+		for (int row = 1; row < 4; row++) {
+			__m128i texels = _mm_loadu_si128((const __m128i*)(block + row * 16));
+			low = _mm_min_epu8(low, texels);
+			high = _mm_max_epu8(high, texels);
+		}
+
+		// Fold the four texel lanes down to one
+		low = _mm_min_epu8(low, _mm_srli_si128(low, 8));
+		low = _mm_min_epu8(low, _mm_srli_si128(low, 4));
+		high = _mm_max_epu8(high, _mm_srli_si128(high, 8));
+		high = _mm_max_epu8(high, _mm_srli_si128(high, 4));
+
+		int32_t lowBits = _mm_cvtsi128_si32(low);
+		int32_t highBits = _mm_cvtsi128_si32(high);
+		memcpy(minColour, &lowBits, 4);
+		memcpy(maxColour, &highBits, 4);
+#else
+		memcpy(minColour, block, 4);
+		memcpy(maxColour, block, 4);
+		for (int i = 1; i < 16; i++) {
+			for (int channel = 0; channel < 4; channel++) {
+				minColour[channel] = std::min(minColour[channel], block[i * 4 + channel]);
+				maxColour[channel] = std::max(maxColour[channel], block[i * 4 + channel]);
+			}
+		}
+#endif
+	}
+
+	// 2-bit index of the closest palette entry for every texel, by summed absolute RGB difference
+	uint32_t selectIndices(const uint8_t* block, const uint32_t* palette) {
+
+		uint32_t indices = 0;
+
+#ifdef BLOCKENCODER_SSE2
+		const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+		const __m128i evenBytes = _mm_set1_epi32(0x00FF00FF);
+		const __m128i ones = _mm_set1_epi16(1);
+
+		for (int row = 0; row < 4; row++) {
+
+			__m128i texels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(block + row * 16)), rgbMask);
+
+			__m128i best = _mm_set1_epi32(0x7FFFFFFF);
+			__m128i bestIndex = _mm_setzero_si128();
+
+			for (int entry = 0; entry < 4; entry++) {
+				__m128i colour = _mm_set1_epi32((int)palette[entry]);
+				__m128i difference = _mm_or_si128(_mm_subs_epu8(texels, colour), _mm_subs_epu8(colour, texels));
+
+				// Bytes to 16-bit pairs (R+G, B+0), then to one 32-bit sum per texel
+				__m128i pairs = _mm_add_epi16(_mm_and_si128(difference, evenBytes), _mm_srli_epi16(difference, 8));
+				__m128i distance = _mm_madd_epi16(pairs, ones);
+
+				__m128i closer = _mm_cmplt_epi32(distance, best);
+				best = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best));
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(entry)), _mm_andnot_si128(closer, bestIndex));
+			}
+
+			int32_t lanes[4];
+			_mm_storeu_si128((__m128i*)lanes, bestIndex);
+			for (int i = 0; i < 4; i++)
+				indices |= (uint32_t)lanes[i] << ((row * 4 + i) * 2);
+		}
+#else
+		for (int i = 0; i < 16; i++) {
+			const uint8_t* texel = block + i * 4;
+			int best = 0x7FFFFFFF;
+			uint32_t bestIndex = 0;
+			for (uint32_t entry = 0; entry < 4; entry++) {
+				int distance = 0;
+				for (int channel = 0; channel < 3; channel++)
+					distance += abs((int)texel[channel] - (int)((palette[entry] >> (channel * 8)) & 0xFF));
+				if (distance < best) {
+					best = distance;
+					bestIndex = entry;
+				}
+			}
+			indices |= bestIndex << (i * 2);
+		}
+#endif
+
+		return indices;
+	}
+
+	// BC1 colour block, always in four-colour mode
+	void encodeColourBlock(const uint8_t* block, uint8_t* out) {
+
+		uint8_t minColour[4], maxColour[4];
+		boundingBox(block, minColour, maxColour);
+
+		// Pull the endpoints in so the interpolated entries land on the bulk of the colours
+		for (int channel = 0; channel < 3; channel++) {
+			int inset = (maxColour[channel] - minColour[channel]) >> 4;
+			minColour[channel] = (uint8_t)std::min(minColour[channel] + inset, 255);
+			maxColour[channel] = (uint8_t)std::max(maxColour[channel] - inset, 0);
+		}
+
+		// The per-channel maximum always quantises to the larger 565 value
+		uint16_t colour0 = to565(maxColour);
+		uint16_t colour1 = to565(minColour);
+
+		uint32_t indices = 0;
+		if (colour0 != colour1) {
+			uint32_t palette[4];
+			palette[0] = from565(colour0);
+			palette[1] = from565(colour1);
+			palette[2] = blend(palette[0], palette[1], 2, 1);
+			palette[3] = blend(palette[0], palette[1], 1, 2);
+			indices = selectIndices(block, palette);
+		}
+
+		out[0] = (uint8_t)(colour0 & 0xFF);
+		out[1] = (uint8_t)(colour0 >> 8);
+		out[2] = (uint8_t)(colour1 & 0xFF);
+		out[3] = (uint8_t)(colour1 >> 8);
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (uint8_t)(indices >> (i * 8));
+	}
+
+	// BC4-style block for one channel, in eight-value mode
+	void encodeChannelBlock(const uint8_t* block, int channel, uint8_t* out) {
+
+		uint8_t low = 255, high = 0;
+		for (int i = 0; i < 16; i++) {
+			low = std::min(low, block[i * 4 + channel]);
+			high = std::max(high, block[i * 4 + channel]);
+		}
+
+		uint64_t indices = 0;
+		if (high > low) {
+			int range = high - low;
+			for (int i = 0; i < 16; i++) {
+				// Position on the ramp from low (0) to high (7), rounded
+				int step = ((block[i * 4 + channel] - low) * 14 + range) / (2 * range);
+				uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+				indices |= index << (i * 3);
+			}
+		}
+
+		out[0] = high;
+		out[1] = low;
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (uint8_t)(indices >> (i * 8));
+	}
+}
+
+bool BlockEncoder::isOpaque(const uint8_t* rgba, uint32_t width, uint32_t height) {
+	size_t texels = (size_t)width * height;
+	for (size_t i = 0; i < texels; i++) {
+		if (rgba[i * 4 + 3] != 255)
+			return false;
+	}
+	return true;
+}
+
+void BlockEncoder::encode(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* destination) {
+
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	size_t bytes = blockBytes(format);
+
+	WorkerPool::shared().parallelFor(blocksY, [=](size_t blockY) {
+
+		uint8_t block[64];
+		uint8_t* out = destination + blockY * blocksX * bytes;
+
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++, out += bytes) {
+
+			gatherBlock(rgba, width, height, blockX, (uint32_t)blockY, block);
+
+			switch (format) {
+			case BlockFormat::BC1:
+				encodeColourBlock(block, out);
+				break;
+			case BlockFormat::BC3:
+				encodeChannelBlock(block, 3, out);
+				encodeColourBlock(block, out + 8);
+				break;
+			case BlockFormat::BC5:
+				encodeChannelBlock(block, 0, out);
+				encodeChannelBlock(block, 1, out + 8);
+				break;
+			}
+		}
+	});
+}
@@ -0,0 +1,42 @@
+#ifndef BLOCKENCODER_H
+#define BLOCKENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// BCn formats the encoder can produce
+enum class BlockFormat {
+	BC1,	// RGB, 8 bytes per 4x4 block; alpha is dropped
+	BC3,	// RGBA, 16 bytes per block: BC4-style alpha followed by a BC1 colour block
+	BC5		// RG, 16 bytes per block: two BC4-style blocks, for normal maps
+};
+
+// Real-time BCn encoder for tightly packed RGBA8 images.
+//
+// Colour blocks use bounding-box endpoints inset by 1/16 of the range, with
+// each texel snapped to the closest palette entry (after van Waveren, "Real-Time
+// DXT Compression"). Quality is below an exhaustive encoder but it keeps up
+// with loading. Rows of blocks are spread over WorkerPool::shared() and the
+// per-block work uses SSE2 where the target has it.
+class BlockEncoder {
+
+public:
+
+	static size_t blockBytes(BlockFormat format) {
+		return format == BlockFormat::BC1 ? 8 : 16;
+	}
+
+	// Bytes of output for a width x height image; partial blocks round up
+	static size_t encodedSize(BlockFormat format, uint32_t width, uint32_t height) {
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+	}
+
+	// True if every texel has alpha 255, i.e. BC1 loses nothing over BC3
+	static bool isOpaque(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+	// Writes encodedSize(format, width, height) bytes to destination. Edge
+	// blocks repeat the last row and column.
+	static void encode(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* destination);
+};
+
+#endif
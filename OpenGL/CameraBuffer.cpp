@@ -0,0 +1,29 @@
+#include "CameraBuffer.h"
+
+CameraBuffer::CameraBuffer() : buffer(0) {}
+
+void CameraBuffer::update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eyePos) {
+
+	if (buffer == 0) {
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraRecord), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer);
+	}
+
+	CameraRecord record;
+	record.view = view;
+	record.projection = projection;
+	record.viewProjection = projection * view;
+	record.eyePos = glm::vec4(eyePos, 1.0f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraRecord), &record);
+}
+
+void CameraBuffer::release() {
+	if (buffer != 0)
+		glDeleteBuffers(1, &buffer);
+
+	buffer = 0;
+}
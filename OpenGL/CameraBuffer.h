@@ -0,0 +1,41 @@
+#ifndef CAMERABUFFER_H
+#define CAMERABUFFER_H
+
+#include "GLExtensions.h"
+#include <glm/glm.hpp>
+
+// std140 layout of the CameraBlock uniform block shared by every program
+struct CameraRecord {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 eyePos;
+};
+
+static_assert(sizeof(CameraRecord) == 208, "CameraRecord must match the std140 CameraBlock layout");
+
+// Per-frame camera uniform buffer. It is written once per frame and read by
+// both the basic and skybox programs, so view and projection are no longer
+// uploaded to each program separately.
+class CameraBuffer {
+
+private:
+
+	GLuint buffer;
+
+public:
+
+	// Uniform buffer binding point of CameraBlock
+	static const GLuint BINDING = 0;
+
+	CameraBuffer();
+	CameraBuffer(const CameraBuffer&) = delete;
+	CameraBuffer& operator=(const CameraBuffer&) = delete;
+
+	void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eyePos);
+
+	// Frees the GL buffer; must run before the context is destroyed
+	void release();
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include "Light.h"
+#include "StaticModel.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// Component types held by EntityRegistry. They are plain data; the systems
+// in Systems.h do the work.
+
+// Placement of the entity's SceneGraph node relative to its parent
+struct TransformComponent {
+	glm::vec3 position;
+	float heading;	// Degrees about +y; 0 faces -z, positive turns towards +x
+	glm::vec3 scale;
+	GLuint node;
+	bool dirty;	// Set whenever the fields change; cleared once the node is written
+};
+
+// Motion along the entity's own heading
+struct VelocityComponent {
+	float forward;	// Units per second
+	float turn;	// Degrees per second
+};
+
+enum RenderFlags {
+	RENDER_OCCLUDER = 1 << 0,	// Rasterised into the occlusion buffer
+	RENDER_OCCLUDABLE = 1 << 1	// Tested against it
+};
+
+// A model drawn at the entity's node. Entities may share a model; each keeps
+// its own level of detail and cull slot in drawState.
+struct RenderableComponent {
+	StaticModel* model;
+	GLuint objectIndex;	// ObjectBuffer record the node's transform goes to
+	uint32_t flags;	// RenderFlags
+	ModelDrawState drawState;
+};
+
+struct LightComponent {
+	Light light;
+	GLuint node;	// SceneGraph node the light rides on, or SceneGraph::NONE to stay put
+	glm::vec3 localPosition;
+	bool followsView;	// Placed at the eye and aimed along the view every frame instead
+};
+
+#endif
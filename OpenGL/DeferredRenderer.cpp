@@ -0,0 +1,375 @@
+#include "DeferredRenderer.h"
+#include "FrameStats.h"
+#include "GLStateCache.h"
+#include "Light.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+const GLfloat DeferredRenderer::MAX_CONE_ANGLE = 1.0472f;	// 60 degrees
+
+// Segments around the volume meshes; the meshes are pushed out so their
+// faces, not just their vertices, enclose the unit sphere or cone
+static const int VOLUME_SEGMENTS = 16;
+static const int VOLUME_RINGS = 8;
+static const GLfloat PI = 3.14159265f;
+
+static const GLuint SHAPE_SPHERE = 0;
+static const GLuint SHAPE_CONE = 1;
+static const GLuint SHAPE_FULLSCREEN = 2;
+
+DeferredRenderer::DeferredRenderer() :
+	gbuffer(0), depthTexture(0), width(0), height(0), targetFramebuffer(0),
+	emptyVAO(0), volumeBuffer(0), volumeCapacity(0), lightProgram(0), resolveProgram(0)
+{
+	targets[0] = targets[1] = targets[2] = 0;
+	sphere = VolumeMesh();
+	cone = VolumeMesh();
+}
+
+void DeferredRenderer::setPrograms(GLuint lightProgramIn, GLuint resolveProgramIn) {
+
+	lightProgram = lightProgramIn;
+	resolveProgram = resolveProgramIn;
+
+	if (lightProgram != 0) {
+		UniformTable uniforms(lightProgram);
+		uVolumeBase = uniforms.get<GLuint>("volumeBase");
+		uVolumeShape = uniforms.get<GLuint>("volumeShape");
+		uInverseViewProjection = uniforms.get<glm::mat4>("inverseViewProjection");
+
+		// G-buffer textures sit on units 0-3 for the whole lighting pass
+		GLStateCache::shared().useProgram(lightProgram);
+		uniforms.get<GLint>("gAlbedo").set(0);
+		uniforms.get<GLint>("gNormal").set(1);
+		uniforms.get<GLint>("gSpecular").set(2);
+		uniforms.get<GLint>("gDepth").set(3);
+	}
+
+	if (resolveProgram != 0) {
+		UniformTable uniforms(resolveProgram);
+		GLStateCache::shared().useProgram(resolveProgram);
+		uniforms.get<GLint>("gDepth").set(3);
+	}
+}
+
+void DeferredRenderer::createTargets(GLsizei widthIn, GLsizei heightIn) {
+
+	releaseTargets();
+
+	width = widthIn;
+	height = heightIn;
+
+	const GLenum formats[3][3] = {
+		{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ GL_RGBA16F, GL_RGBA, GL_FLOAT },
+		{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE }
+	};
+
+	glGenFramebuffers(1, &gbuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, gbuffer);
+
+	glGenTextures(3, targets);
+	for (int i = 0; i < 3; i++) {
+		glBindTexture(GL_TEXTURE_2D, targets[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[i][0], width, height, 0, formats[i][1], formats[i][2], NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, targets[i], 0);
+	}
+
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "DeferredRenderer: G-buffer is incomplete at " << width << "x" << height << std::endl;
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void DeferredRenderer::releaseTargets() {
+
+	if (gbuffer != 0)
+		glDeleteFramebuffers(1, &gbuffer);
+	if (targets[0] != 0)
+		glDeleteTextures(3, targets);
+	if (depthTexture != 0)
+		glDeleteTextures(1, &depthTexture);
+
+	gbuffer = 0;
+	targets[0] = targets[1] = targets[2] = 0;
+	depthTexture = 0;
+}
+
+void DeferredRenderer::createMesh(VolumeMesh& mesh, const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices) {
+
+	mesh.indexCount = (GLsizei)indices.size();
+
+	glGenVertexArrays(1, &mesh.vao);
+	glGenBuffers(1, &mesh.vbo);
+	glGenBuffers(1, &mesh.ebo);
+
+	glBindVertexArray(mesh.vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+	glBindVertexArray(0);
+}
+
+// Both meshes wind counter-clockwise seen from outside
+void DeferredRenderer::createVolumes() {
+
+	std::vector<glm::vec3> positions;
+	std::vector<GLuint> indices;
+
+	// UV sphere
+	GLfloat sphereScale = 1.0f / (cosf(PI / VOLUME_SEGMENTS) * cosf(PI / VOLUME_RINGS));
+
+	for (int ring = 0; ring <= VOLUME_RINGS; ring++) {
+		GLfloat phi = PI * ring / VOLUME_RINGS;
+		for (int segment = 0; segment <= VOLUME_SEGMENTS; segment++) {
+			GLfloat theta = 2.0f * PI * segment / VOLUME_SEGMENTS;
+			positions.push_back(glm::vec3(sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta)) * sphereScale);
+		}
+	}
+
+	for (int ring = 0; ring < VOLUME_RINGS; ring++) {
+		for (int segment = 0; segment < VOLUME_SEGMENTS; segment++) {
+			GLuint a = ring * (VOLUME_SEGMENTS + 1) + segment;
+			GLuint b = a + VOLUME_SEGMENTS + 1;
+
+			indices.push_back(a);
+			indices.push_back(a + 1);
+			indices.push_back(b);
+
+			indices.push_back(a + 1);
+			indices.push_back(b + 1);
+			indices.push_back(b);
+		}
+	}
+
+	createMesh(sphere, positions, indices);
+
+	// Cone with its apex at the origin and a capped base at z = 1
+	positions.clear();
+	indices.clear();
+
+	GLfloat coneScale = 1.0f / cosf(PI / VOLUME_SEGMENTS);
+
+	positions.push_back(glm::vec3(0.0f));
+	for (int segment = 0; segment < VOLUME_SEGMENTS; segment++) {
+		GLfloat theta = 2.0f * PI * segment / VOLUME_SEGMENTS;
+		positions.push_back(glm::vec3(cosf(theta) * coneScale, sinf(theta) * coneScale, 1.0f));
+	}
+	positions.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+
+	GLuint centre = VOLUME_SEGMENTS + 1;
+	for (GLuint segment = 0; segment < (GLuint)VOLUME_SEGMENTS; segment++) {
+		GLuint current = 1 + segment;
+		GLuint next = 1 + (segment + 1) % VOLUME_SEGMENTS;
+
+		indices.push_back(0);
+		indices.push_back(next);
+		indices.push_back(current);
+
+		indices.push_back(centre);
+		indices.push_back(current);
+		indices.push_back(next);
+	}
+
+	createMesh(cone, positions, indices);
+
+	// Attribute-less draws (fullscreen triangles) still need a vertex array bound
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+void DeferredRenderer::beginGeometry() {
+
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// Creation binds textures and VAOs directly, behind the state cache
+	if (gbuffer == 0 || viewport[2] != width || viewport[3] != height) {
+		createTargets(viewport[2], viewport[3]);
+		GLStateCache::shared().invalidate();
+	}
+
+	if (emptyVAO == 0) {
+		createVolumes();
+		GLStateCache::shared().invalidate();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gbuffer);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::uploadVolumes() {
+
+	// Unsized arrays still need a non-empty buffer behind them
+	GLuint count = std::max<GLuint>(1, (GLuint)volumes.size());
+
+	if (volumeBuffer == 0 || count > volumeCapacity) {
+		if (volumeBuffer == 0)
+			glGenBuffers(1, &volumeBuffer);
+
+		volumeCapacity = std::max<GLuint>(64, std::max<GLuint>(volumeCapacity * 2, count));
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, volumeCapacity * sizeof(LightVolumeRecord), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VOLUME_BINDING, volumeBuffer);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, volumeBuffer);
+	if (!volumes.empty())
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, volumes.size() * sizeof(LightVolumeRecord), volumes.data());
+}
+
+void DeferredRenderer::drawVolumes(const VolumeMesh* mesh, GLuint shape, GLuint base, GLsizei count) {
+
+	if (count == 0)
+		return;
+
+	uVolumeShape.set(shape);
+	uVolumeBase.set(base);
+
+	if (mesh != nullptr) {
+		GLStateCache::shared().bindVertexArray(mesh->vao);
+		glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, 0, count);
+	}
+	else {
+		GLStateCache::shared().bindVertexArray(emptyVAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 3, count);
+	}
+
+	frameStats.drawCalls++;
+}
+
+void DeferredRenderer::shade(const LightBuffer& lights, const glm::mat4& viewProjection) {
+
+	// Sort the enabled lights by the volume that bounds them: spheres first, then cones, then fullscreen
+	volumes.clear();
+	coneVolumes.clear();
+	screenVolumes.clear();
+
+	for (GLuint i = 0; i < lights.size(); i++) {
+
+		const LightRecord& record = lights.get(i);
+		if (record.enabled == 0)
+			continue;
+
+		LightVolumeRecord volume = LightVolumeRecord();
+		volume.light = i;
+
+		if (record.type == (GLint)LightType::DIRECTIONAL) {
+			screenVolumes.push_back(volume);
+			continue;
+		}
+
+		volume.range = LightBuffer::range(record);
+		if (volume.range <= 0.0f)
+			continue;
+
+		if (volume.range == FLT_MAX) {
+			screenVolumes.push_back(volume);
+			continue;
+		}
+
+		GLfloat outerAngle = acosf(glm::clamp(record.outerCutOff, -1.0f, 1.0f));
+		if (record.type == (GLint)LightType::SPOT && outerAngle < MAX_CONE_ANGLE) {
+			volume.radius = volume.range * tanf(outerAngle);
+			coneVolumes.push_back(volume);
+		}
+		else {
+			volumes.push_back(volume);
+		}
+	}
+
+	GLuint sphereCount = (GLuint)volumes.size();
+	GLuint coneCount = (GLuint)coneVolumes.size();
+	volumes.insert(volumes.end(), coneVolumes.begin(), coneVolumes.end());
+	volumes.insert(volumes.end(), screenVolumes.begin(), screenVolumes.end());
+
+	uploadVolumes();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+
+	GLStateCache& state = GLStateCache::shared();
+
+	for (GLuint i = 0; i < 3; i++)
+		state.bindTexture(i, GL_TEXTURE_2D, targets[i]);
+	state.bindTexture(3, GL_TEXTURE_2D, depthTexture);
+
+	// Clear the covered pixels and bring the scene depth across
+	state.useProgram(resolveProgram);
+	state.depthFunc(GL_ALWAYS);
+	state.bindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	frameStats.drawCalls++;
+
+	state.useProgram(lightProgram);
+	uInverseViewProjection.set(glm::inverse(viewProjection));
+
+	state.setEnabled(GL_BLEND, true);
+	state.blendFunc(GL_ONE, GL_ONE);
+	state.depthMask(GL_FALSE);
+
+	// Back faces that lie behind the surface; this still works with the eye
+	// inside a volume, and depth clamping stops the far plane cutting volumes open
+	state.setEnabled(GL_DEPTH_CLAMP, true);
+	state.cullFace(GL_FRONT);
+	state.depthFunc(GL_GEQUAL);
+
+	drawVolumes(&sphere, SHAPE_SPHERE, 0, sphereCount);
+	drawVolumes(&cone, SHAPE_CONE, sphereCount, coneCount);
+
+	state.setEnabled(GL_DEPTH_TEST, false);
+	state.cullFace(GL_BACK);
+	drawVolumes(nullptr, SHAPE_FULLSCREEN, sphereCount + coneCount, (GLsizei)screenVolumes.size());
+
+	state.setEnabled(GL_DEPTH_TEST, true);
+	state.depthFunc(GL_LESS);
+	state.depthMask(GL_TRUE);
+	state.setEnabled(GL_DEPTH_CLAMP, false);
+	state.setEnabled(GL_BLEND, false);
+}
+
+void DeferredRenderer::release() {
+
+	releaseTargets();
+
+	VolumeMesh* meshes[2] = { &sphere, &cone };
+	for (VolumeMesh* mesh : meshes) {
+		if (mesh->vao != 0) {
+			glDeleteVertexArrays(1, &mesh->vao);
+			glDeleteBuffers(1, &mesh->vbo);
+			glDeleteBuffers(1, &mesh->ebo);
+		}
+		*mesh = VolumeMesh();
+	}
+
+	if (emptyVAO != 0)
+		glDeleteVertexArrays(1, &emptyVAO);
+	if (volumeBuffer != 0)
+		glDeleteBuffers(1, &volumeBuffer);
+
+	emptyVAO = 0;
+	volumeBuffer = 0;
+	volumeCapacity = 0;
+}
@@ -0,0 +1,102 @@
+#ifndef DEFERREDRENDERER_H
+#define DEFERREDRENDERER_H
+
+#include "LightBuffer.h"
+#include "UniformTable.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// One instance of a light volume draw, as laid out (std430) in Deferred_light.vert
+struct LightVolumeRecord {
+	GLuint light;		// Index into LightBlock
+	GLfloat range;		// Sphere radius, or cone length
+	GLfloat radius;		// Cone base radius
+	GLfloat padding;
+};
+
+static_assert(sizeof(LightVolumeRecord) == 16, "LightVolumeRecord must match the std430 LightVolume layout");
+
+// Deferred alternative to the forward light loop. The geometry pass writes
+// each visible surface into a G-buffer once; every light is then drawn as a
+// bounding volume (a sphere per bulb, a cone per spot, a fullscreen triangle
+// per directional light) that adds its contribution to the pixels inside it.
+// Lighting cost follows the visible pixels rather than the shaded fragments.
+//
+// G-buffer targets:
+//   0  RGBA8     albedo
+//   1  RGBA16F   world-space normal, specular exponent
+//   2  RGBA8     specular colour
+//   depth        DEPTH_COMPONENT32F, used to rebuild the world position
+class DeferredRenderer {
+
+private:
+
+	struct VolumeMesh {
+		GLuint vao;
+		GLuint vbo;
+		GLuint ebo;
+		GLsizei indexCount;
+	};
+
+	GLuint gbuffer;
+	GLuint targets[3];
+	GLuint depthTexture;
+	GLsizei width;
+	GLsizei height;
+
+	GLint targetFramebuffer;	// Bound when beginGeometry() was called; lit into by shade()
+
+	VolumeMesh sphere;
+	VolumeMesh cone;
+	GLuint emptyVAO;
+
+	GLuint volumeBuffer;
+	GLuint volumeCapacity;	// Records the GPU volume buffer can hold
+	std::vector<LightVolumeRecord> volumes;
+	std::vector<LightVolumeRecord> coneVolumes;
+	std::vector<LightVolumeRecord> screenVolumes;
+
+	GLuint lightProgram;
+	GLuint resolveProgram;
+	Uniform<GLuint> uVolumeBase;
+	Uniform<GLuint> uVolumeShape;
+	Uniform<glm::mat4> uInverseViewProjection;
+
+	void createTargets(GLsizei widthIn, GLsizei heightIn);
+	void releaseTargets();
+	void createMesh(VolumeMesh& mesh, const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices);
+	void createVolumes();
+	void uploadVolumes();
+	void drawVolumes(const VolumeMesh* mesh, GLuint shape, GLuint base, GLsizei count);
+
+public:
+
+	// Matches layout(binding = 4) on LightVolumeBlock
+	static const GLuint VOLUME_BINDING = 4;
+
+	// Spots with a wider outer cone than this (radians) are bounded by a sphere
+	static const GLfloat MAX_CONE_ANGLE;
+
+	DeferredRenderer();
+	DeferredRenderer(const DeferredRenderer&) = delete;
+	DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+	// Deferred_light and Deferred_resolve; either may be 0 if it failed to build
+	void setPrograms(GLuint lightProgramIn, GLuint resolveProgramIn);
+
+	bool isReady() const {
+		return lightProgram != 0 && resolveProgram != 0;
+	}
+
+	// Redirects drawing into the G-buffer, resized to the current viewport if
+	// needed. Draw the scene with the geometry program afterwards.
+	void beginGeometry();
+
+	// Lights the G-buffer into the framebuffer that was bound at beginGeometry()
+	void shade(const LightBuffer& lights, const glm::mat4& viewProjection);
+
+	// Frees the GL objects; must run before the context is destroyed
+	void release();
+};
+
+#endif
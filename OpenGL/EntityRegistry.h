@@ -0,0 +1,160 @@
+#ifndef ENTITYREGISTRY_H
+#define ENTITYREGISTRY_H
+
+#include "Components.h"
+#include <cstdint>
+#include <vector>
+
+typedef uint32_t Entity;
+
+// Sparse set of one component type. Components sit packed in a dense array
+// with no gaps, so systems walk them linearly; the sparse array maps an
+// entity to its slot for lookups and joins. Removal moves the last component
+// into the hole, so order is not preserved.
+template <typename Component>
+class ComponentPool {
+
+private:
+
+	static const uint32_t ABSENT = 0xffffffff;
+
+	std::vector<uint32_t> sparse;	// Entity -> dense slot, or ABSENT
+	std::vector<Entity> entities;	// Dense slot -> entity
+	std::vector<Component> components;
+
+public:
+
+	// Replaces the entity's component if it already has one
+	Component& add(Entity entity, const Component& component) {
+
+		if (entity >= sparse.size())
+			sparse.resize(entity + 1, (uint32_t)ABSENT);
+
+		if (sparse[entity] != ABSENT) {
+			components[sparse[entity]] = component;
+			return components[sparse[entity]];
+		}
+
+		sparse[entity] = (uint32_t)components.size();
+		entities.push_back(entity);
+		components.push_back(component);
+		return components.back();
+	}
+
+	void remove(Entity entity) {
+
+		if (!has(entity))
+			return;
+
+		uint32_t slot = sparse[entity];
+		uint32_t last = (uint32_t)components.size() - 1;
+		if (slot != last) {
+			components[slot] = components[last];
+			entities[slot] = entities[last];
+			sparse[entities[slot]] = slot;
+		}
+
+		components.pop_back();
+		entities.pop_back();
+		sparse[entity] = ABSENT;
+	}
+
+	bool has(Entity entity) const {
+		return entity < sparse.size() && sparse[entity] != ABSENT;
+	}
+
+	// The entity must have the component
+	Component& get(Entity entity) {
+		return components[sparse[entity]];
+	}
+	const Component& get(Entity entity) const {
+		return components[sparse[entity]];
+	}
+
+	// nullptr if the entity does not have the component
+	Component* find(Entity entity) {
+		return has(entity) ? &components[sparse[entity]] : nullptr;
+	}
+	const Component* find(Entity entity) const {
+		return has(entity) ? &components[sparse[entity]] : nullptr;
+	}
+
+	// Dense access, for systems
+	uint32_t size() const {
+		return (uint32_t)components.size();
+	}
+	Component& at(uint32_t slot) {
+		return components[slot];
+	}
+	const Component& at(uint32_t slot) const {
+		return components[slot];
+	}
+	Entity entityAt(uint32_t slot) const {
+		return entities[slot];
+	}
+
+	void reserve(uint32_t count) {
+		entities.reserve(count);
+		components.reserve(count);
+	}
+};
+
+// Entities and their components. An entity is only an index; destroyed
+// indices are handed out again by create().
+//
+// The registry owns the components and nothing else. Whatever they refer to
+// (SceneGraph nodes, ObjectBuffer records, models) belongs to the code that
+// created it and outlives destroy().
+class EntityRegistry {
+
+private:
+
+	std::vector<uint8_t> alive;	// Per index: created and not destroyed since
+	std::vector<Entity> freeEntities;
+
+public:
+
+	ComponentPool<TransformComponent> transforms;
+	ComponentPool<VelocityComponent> velocities;
+	ComponentPool<RenderableComponent> renderables;
+	ComponentPool<LightComponent> lights;
+
+	EntityRegistry() {}
+
+	EntityRegistry(const EntityRegistry&) = delete;
+	EntityRegistry& operator=(const EntityRegistry&) = delete;
+
+	Entity create() {
+		if (freeEntities.empty()) {
+			alive.push_back(1);
+			return (Entity)alive.size() - 1;
+		}
+
+		Entity entity = freeEntities.back();
+		freeEntities.pop_back();
+		alive[entity] = 1;
+		return entity;
+	}
+
+	bool isAlive(Entity entity) const {
+		return entity < alive.size() && alive[entity];
+	}
+
+	// Removes every component of the entity and recycles its index. Destroying
+	// an entity that is not alive does nothing, so an index is never free twice.
+	void destroy(Entity entity) {
+
+		if (!isAlive(entity))
+			return;
+
+		transforms.remove(entity);
+		velocities.remove(entity);
+		renderables.remove(entity);
+		lights.remove(entity);
+
+		alive[entity] = 0;
+		freeEntities.push_back(entity);
+	}
+};
+
+#endif
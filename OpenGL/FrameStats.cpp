@@ -0,0 +1,3 @@
+#include "FrameStats.h"
+
+FrameStats frameStats;
@@ -0,0 +1,58 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <glad/glad.h>
+
+// Counters gathered while a frame is being submitted. Reset at the start of
+// every frame; read by the benchmark report and the window title.
+struct FrameStats {
+
+	// Draw calls issued by the engine, and the triangles they cover
+	GLuint drawCalls;
+	GLuint triangles;
+
+	// Meshes, and their triangles, skipped by frustum or occlusion culling
+	GLuint culledObjects;
+	GLuint culledTriangles;
+
+	// Of those, meshes hidden behind occluders, and the CPU time spent rasterising them
+	GLuint occludedObjects;
+	double occlusionMs;
+
+	// State changes issued by the RenderQueue, and what submission order would have needed
+	GLuint programSwitches;
+	GLuint textureSwitches;
+	GLuint vertexArraySwitches;
+	GLuint unsortedProgramSwitches;
+	GLuint unsortedTextureSwitches;
+	GLuint unsortedVertexArraySwitches;
+
+	// State calls that reached the driver through the GLStateCache, and those it dropped as redundant
+	GLuint stateCallsIssued;
+	GLuint stateCallsElided;
+
+	FrameStats() {
+		reset();
+	}
+
+	void reset() {
+		drawCalls = 0;
+		triangles = 0;
+		culledObjects = 0;
+		culledTriangles = 0;
+		occludedObjects = 0;
+		occlusionMs = 0.0;
+		programSwitches = 0;
+		textureSwitches = 0;
+		vertexArraySwitches = 0;
+		unsortedProgramSwitches = 0;
+		unsortedTextureSwitches = 0;
+		unsortedVertexArraySwitches = 0;
+		stateCallsIssued = 0;
+		stateCallsElided = 0;
+	}
+};
+
+extern FrameStats frameStats;
+
+#endif
@@ -0,0 +1,118 @@
+#include "FrustumCuller.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUMCULLER_SSE2
+#include <emmintrin.h>
+#endif
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+
+	// Rows of the (column-major) matrix
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	return frustum;
+}
+
+FrustumCuller::FrustumCuller() : count(0) {
+	frustum = Frustum();
+}
+
+void FrustumCuller::begin(const glm::mat4& viewProjection) {
+	frustum = Frustum::fromMatrix(viewProjection);
+	count = 0;
+}
+
+GLuint FrustumCuller::add(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& transform) {
+
+	glm::vec3 centre = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+
+	// Centre moves with the transform; the extent grows to the box's world-space AABB
+	glm::vec3 worldCentre = glm::vec3(transform * glm::vec4(centre, 1.0f));
+	glm::vec3 worldExtent;
+	for (int axis = 0; axis < 3; axis++) {
+		worldExtent[axis] =
+			fabsf(transform[0][axis]) * extent.x +
+			fabsf(transform[1][axis]) * extent.y +
+			fabsf(transform[2][axis]) * extent.z;
+	}
+
+	GLuint slot = count++;
+
+	// Padded so run() can always load a full batch
+	GLuint padded = (count + BATCH - 1) / BATCH * BATCH;
+	if (centreX.size() < padded) {
+		centreX.resize(padded, 0.0f);
+		centreY.resize(padded, 0.0f);
+		centreZ.resize(padded, 0.0f);
+		extentX.resize(padded, 0.0f);
+		extentY.resize(padded, 0.0f);
+		extentZ.resize(padded, 0.0f);
+		visible.resize(padded, 1);
+	}
+
+	centreX[slot] = worldCentre.x;
+	centreY[slot] = worldCentre.y;
+	centreZ[slot] = worldCentre.z;
+	extentX[slot] = worldExtent.x;
+	extentY[slot] = worldExtent.y;
+	extentZ[slot] = worldExtent.z;
+	return slot;
+}
+
+// A box is outside when, for some plane, even its corner furthest along the
+// normal is behind it: dot(n, centre) + dot(|n|, extent) + w < 0
+void FrustumCuller::run() {
+
+	for (GLuint first = 0; first < count; first += BATCH) {
+
+#ifdef FRUSTUMCULLER_SSE2
+		__m128 cx = _mm_loadu_ps(&centreX[first]);
+		__m128 cy = _mm_loadu_ps(&centreY[first]);
+		__m128 cz = _mm_loadu_ps(&centreZ[first]);
+		__m128 ex = _mm_loadu_ps(&extentX[first]);
+		__m128 ey = _mm_loadu_ps(&extentY[first]);
+		__m128 ez = _mm_loadu_ps(&extentZ[first]);
+
+		__m128 outside = _mm_setzero_ps();
+
+		for (int i = 0; i < 6; i++) {
+			const glm::vec4& plane = frustum.planes[i];
+
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			__m128 reach = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(fabsf(plane.y)))),
+				_mm_mul_ps(ez, _mm_set1_ps(fabsf(plane.z))));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (GLuint lane = 0; lane < BATCH; lane++)
+			visible[first + lane] = (mask >> lane) & 1 ? 0 : 1;
+#else
+		for (GLuint slot = first; slot < first + BATCH; slot++) {
+			bool outside = false;
+			for (int i = 0; i < 6 && !outside; i++) {
+				const glm::vec4& plane = frustum.planes[i];
+				float distance = centreX[slot] * plane.x + centreY[slot] * plane.y + centreZ[slot] * plane.z + plane.w;
+				float reach = extentX[slot] * fabsf(plane.x) + extentY[slot] * fabsf(plane.y) + extentZ[slot] * fabsf(plane.z);
+				outside = distance + reach < 0.0f;
+			}
+			visible[slot] = outside ? 0 : 1;
+		}
+#endif
+	}
+}
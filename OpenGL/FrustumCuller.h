@@ -0,0 +1,72 @@
+#ifndef FRUSTUMCULLER_H
+#define FRUSTUMCULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Six clip planes (xyz normal, w distance) with the normals pointing inwards.
+// The planes are not normalised; only the sign of a distance is ever used.
+struct Frustum {
+	glm::vec4 planes[6];
+
+	// Left, right, bottom, top, near and far planes of a view-projection matrix
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+// Culling stage run before anything is submitted. Each frame, callers queue
+// local-space AABBs under a transform with add(); run() tests the resulting
+// world-space boxes against the frustum planes in batches of BATCH with SSE,
+// and isVisible() reports the outcome per slot.
+class FrustumCuller {
+
+private:
+
+	Frustum frustum;
+
+	// World-space boxes as centre and half extent, structure of arrays padded to a whole batch
+	std::vector<float> centreX;
+	std::vector<float> centreY;
+	std::vector<float> centreZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	std::vector<unsigned char> visible;
+	GLuint count;
+
+public:
+
+	// Boxes tested per SIMD step
+	static const GLuint BATCH = 4;
+
+	FrustumCuller();
+
+	// Starts a frame with a new frustum and no boxes
+	void begin(const glm::mat4& viewProjection);
+
+	// Queues a local-space box under transform; returns its slot
+	GLuint add(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& transform);
+
+	// Tests every box queued since begin()
+	void run();
+
+	bool isVisible(GLuint slot) const {
+		return visible[slot] != 0;
+	}
+
+	// For later stages (occlusion) that reject more after run()
+	void hide(GLuint slot) {
+		visible[slot] = 0;
+	}
+	glm::vec3 getCentre(GLuint slot) const {
+		return glm::vec3(centreX[slot], centreY[slot], centreZ[slot]);
+	}
+	glm::vec3 getExtent(GLuint slot) const {
+		return glm::vec3(extentX[slot], extentY[slot], extentZ[slot]);
+	}
+	GLuint size() const {
+		return count;
+	}
+};
+
+#endif
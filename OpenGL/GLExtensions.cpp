@@ -0,0 +1,39 @@
+#include "GLExtensions.h"
+#include <cstring>
+
+PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glext_glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri = nullptr;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR = nullptr;
+PFNGLMEMORYBARRIERPROC glext_glMemoryBarrier = nullptr;
+PFNGLDISPATCHCOMPUTEPROC glext_glDispatchCompute = nullptr;
+PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC glext_glMultiDrawElementsIndirectCount = nullptr;
+
+void loadGLExtensions(GLADloadproc load) {
+	glext_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+	glext_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+	glext_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+
+	glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+	if (glext_glMaxShaderCompilerThreadsKHR == nullptr)
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+
+	glext_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+	glext_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+
+	// Core in 4.6; ARB_indirect_parameters has the same signature on older drivers
+	glext_glMultiDrawElementsIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)load("glMultiDrawElementsIndirectCount");
+	if (glext_glMultiDrawElementsIndirectCount == nullptr)
+		glext_glMultiDrawElementsIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)load("glMultiDrawElementsIndirectCountARB");
+}
+
+bool hasGLExtension(const char* name) {
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; i++) {
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != nullptr && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
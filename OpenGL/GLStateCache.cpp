@@ -0,0 +1,169 @@
+#include "GLStateCache.h"
+#include "FrameStats.h"
+
+GLStateCache::GLStateCache() {
+	invalidate();
+}
+
+GLStateCache& GLStateCache::shared() {
+	static GLStateCache cache;
+	return cache;
+}
+
+bool GLStateCache::change(GLuint& cached, GLuint value) {
+
+	if (cached == value) {
+		frameStats.stateCallsElided++;
+		return false;
+	}
+
+	cached = value;
+	frameStats.stateCallsIssued++;
+	return true;
+}
+
+bool GLStateCache::change(GLuint& cachedA, GLuint valueA, GLuint& cachedB, GLuint valueB) {
+
+	if (cachedA == valueA && cachedB == valueB) {
+		frameStats.stateCallsElided++;
+		return false;
+	}
+
+	cachedA = valueA;
+	cachedB = valueB;
+	frameStats.stateCallsIssued++;
+	return true;
+}
+
+void GLStateCache::passThrough() {
+	frameStats.stateCallsIssued++;
+}
+
+int GLStateCache::textureTargetOf(GLenum target) {
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return TEXTURE_TARGET_2D;
+	case GL_TEXTURE_CUBE_MAP:
+		return TEXTURE_TARGET_CUBE_MAP;
+	default:
+		return -1;
+	}
+}
+
+int GLStateCache::bufferTargetOf(GLenum target) {
+	switch (target) {
+	case GL_DRAW_INDIRECT_BUFFER:
+		return BUFFER_TARGET_DRAW_INDIRECT;
+	case GL_PARAMETER_BUFFER:
+		return BUFFER_TARGET_PARAMETER;
+	default:
+		return -1;
+	}
+}
+
+int GLStateCache::capabilityOf(GLenum cap) {
+	switch (cap) {
+	case GL_DEPTH_TEST:
+		return CAPABILITY_DEPTH_TEST;
+	case GL_BLEND:
+		return CAPABILITY_BLEND;
+	case GL_CULL_FACE:
+		return CAPABILITY_CULL_FACE;
+	case GL_DEPTH_CLAMP:
+		return CAPABILITY_DEPTH_CLAMP;
+	default:
+		return -1;
+	}
+}
+
+void GLStateCache::useProgram(GLuint programIn) {
+	if (change(program, programIn))
+		glUseProgram(programIn);
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArrayIn) {
+	if (change(vertexArray, vertexArrayIn))
+		glBindVertexArray(vertexArrayIn);
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer) {
+
+	int slot = bufferTargetOf(target);
+	if (slot < 0) {
+		passThrough();
+		glBindBuffer(target, buffer);
+	}
+	else if (change(buffers[slot], buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+
+	int slot = textureTargetOf(target);
+	if (slot >= 0 && unit < TEXTURE_UNITS && !change(textures[unit][slot], texture))
+		return;
+	if (slot < 0 || unit >= TEXTURE_UNITS)
+		passThrough();
+
+	// The unit only matters to the bind, so it is selected when a bind is made
+	if (change(activeUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, texture);
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled) {
+
+	int slot = capabilityOf(cap);
+	if (slot >= 0 && !change(capabilities[slot], enabled ? GL_TRUE : GL_FALSE))
+		return;
+	if (slot < 0)
+		passThrough();
+
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+}
+
+void GLStateCache::depthMask(GLboolean writes) {
+	if (change(depthWrites, writes))
+		glDepthMask(writes);
+}
+
+void GLStateCache::depthFunc(GLenum func) {
+	if (change(depthTest, func))
+		glDepthFunc(func);
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination) {
+	if (change(blendSource, source, blendDestination, destination))
+		glBlendFunc(source, destination);
+}
+
+void GLStateCache::cullFace(GLenum mode) {
+	if (change(cullMode, mode))
+		glCullFace(mode);
+}
+
+void GLStateCache::invalidate() {
+
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	activeUnit = UNKNOWN;
+
+	for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++) {
+		for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			textures[unit][target] = UNKNOWN;
+	}
+	for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		buffers[target] = UNKNOWN;
+	for (int cap = 0; cap < CAPABILITY_COUNT; cap++)
+		capabilities[cap] = UNKNOWN;
+
+	depthWrites = UNKNOWN;
+	depthTest = UNKNOWN;
+	blendSource = UNKNOWN;
+	blendDestination = UNKNOWN;
+	cullMode = UNKNOWN;
+}
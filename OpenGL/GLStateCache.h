@@ -0,0 +1,98 @@
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+
+#include "GLExtensions.h"
+
+// Shadows the GL state the render loop touches and drops calls that would
+// set it to what it already is. Callers ask for the state each draw needs
+// without tracking what came before; frameStats counts the calls that
+// reached the driver and the ones filtered out.
+//
+// Texture binds select their unit themselves, and only when the bind is
+// actually issued. State the cache does not track (other buffer targets,
+// capabilities and units) passes straight through.
+//
+// Anything bound behind the cache's back makes it stale: code that does so
+// must call invalidate() before the cache is used again. Context thread only.
+class GLStateCache {
+
+public:
+
+	// Units whose 2D and cube map bindings are tracked
+	static const GLuint TEXTURE_UNITS = 16;
+
+private:
+
+	static const GLuint UNKNOWN = 0xffffffff;
+
+	enum TextureTarget {
+		TEXTURE_TARGET_2D,
+		TEXTURE_TARGET_CUBE_MAP,
+		TEXTURE_TARGET_COUNT
+	};
+
+	enum BufferTarget {
+		BUFFER_TARGET_DRAW_INDIRECT,
+		BUFFER_TARGET_PARAMETER,
+		BUFFER_TARGET_COUNT
+	};
+
+	enum Capability {
+		CAPABILITY_DEPTH_TEST,
+		CAPABILITY_BLEND,
+		CAPABILITY_CULL_FACE,
+		CAPABILITY_DEPTH_CLAMP,
+		CAPABILITY_COUNT
+	};
+
+	GLuint program;
+	GLuint vertexArray;
+	GLuint activeUnit;
+	GLuint textures[TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	GLuint buffers[BUFFER_TARGET_COUNT];
+	GLuint capabilities[CAPABILITY_COUNT];	// GL_TRUE, GL_FALSE or UNKNOWN
+	GLuint depthWrites;
+	GLuint depthTest;
+	GLuint blendSource;
+	GLuint blendDestination;
+	GLuint cullMode;
+
+	// Stores value in cached and returns true if the call has to be made
+	static bool change(GLuint& cached, GLuint value);
+	static bool change(GLuint& cachedA, GLuint valueA, GLuint& cachedB, GLuint valueB);
+	static void passThrough();
+
+	static int textureTargetOf(GLenum target);
+	static int bufferTargetOf(GLenum target);
+	static int capabilityOf(GLenum cap);
+
+public:
+
+	GLStateCache();
+
+	GLStateCache(const GLStateCache&) = delete;
+	GLStateCache& operator=(const GLStateCache&) = delete;
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vertexArray);
+	void bindBuffer(GLenum target, GLuint buffer);
+
+	// Binds texture to target on unit (0 for GL_TEXTURE0)
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	// glEnable or glDisable
+	void setEnabled(GLenum cap, bool enabled);
+
+	void depthMask(GLboolean writes);
+	void depthFunc(GLenum func);
+	void blendFunc(GLenum source, GLenum destination);
+	void cullFace(GLenum mode);
+
+	// Forgets everything, so the next call of each kind is issued
+	void invalidate();
+
+	// The cache for the engine's one context
+	static GLStateCache& shared();
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "GeometryArena.h"
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+
+void RangeAllocator::insertFree(GLuint offset, GLuint size) {
+	freeByOffset[offset] = size;
+	freeBySize.insert(std::make_pair(size, offset));
+}
+
+void RangeAllocator::eraseFree(std::map<GLuint, GLuint>::iterator range) {
+	freeBySize.erase(std::make_pair(range->second, range->first));
+	freeByOffset.erase(range);
+}
+
+GLuint RangeAllocator::allocate(GLuint count) {
+
+	if (count == 0)
+		return 0;
+
+	// Smallest free range that fits, lowest offset among equals
+	auto fit = freeBySize.lower_bound(std::make_pair(count, (GLuint)0));
+	if (fit == freeBySize.end())
+		return INVALID;
+
+	GLuint size = fit->first;
+	GLuint offset = fit->second;
+	eraseFree(freeByOffset.find(offset));
+
+	if (size > count)
+		insertFree(offset + count, size - count);
+
+	used += count;
+	return offset;
+}
+
+void RangeAllocator::free(GLuint offset, GLuint count) {
+
+	if (count == 0)
+		return;
+
+	used -= count;
+
+	// Merge with the free ranges either side
+	auto next = freeByOffset.lower_bound(offset);
+	if (next != freeByOffset.end() && offset + count == next->first) {
+		count += next->second;
+		eraseFree(next);
+	}
+
+	auto previous = freeByOffset.lower_bound(offset);
+	if (previous != freeByOffset.begin()) {
+		previous--;
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			count += previous->second;
+			eraseFree(previous);
+		}
+	}
+
+	insertFree(offset, count);
+}
+
+void RangeAllocator::grow(GLuint newCapacity) {
+
+	if (newCapacity <= capacity)
+		return;
+
+	// Pretend the tail was allocated and free it, so it merges with a free range at the old end
+	GLuint tail = newCapacity - capacity;
+	GLuint oldCapacity = capacity;
+	capacity = newCapacity;
+	used += tail;
+	free(oldCapacity, tail);
+}
+
+void RangeAllocator::reset() {
+	freeByOffset.clear();
+	freeBySize.clear();
+	capacity = 0;
+	used = 0;
+}
+
+GeometryArena::GeometryArena() : growCount(0) {
+
+	for (GLuint format = 0; format < FORMAT_COUNT; format++) {
+		vertexPools[format].stride = format == MESH_VERTEX_PACKED ? sizeof(PackedVertex) : sizeof(MeshVertex);
+		vertexPools[format].initialCapacity = INITIAL_VERTICES;
+		vertexPools[format].buffer = 0;
+		vertexArrays[format] = 0;
+	}
+
+	indexPool.stride = sizeof(uint32_t);
+	indexPool.initialCapacity = INITIAL_INDICES;
+	indexPool.buffer = 0;
+}
+
+GeometryArena& GeometryArena::shared() {
+	static GeometryArena arena;
+	return arena;
+}
+
+GLuint GeometryArena::reserve(Pool& pool, GLuint count) {
+
+	GLuint offset = pool.ranges.allocate(count);
+	if (offset != RangeAllocator::INVALID)
+		return offset;
+
+	// Double until the request fits after whatever is free at the end
+	GLuint capacity = std::max(pool.ranges.getCapacity(), pool.initialCapacity);
+	while (capacity < pool.ranges.getCapacity() + count)
+		capacity *= 2;
+	resize(pool, capacity);
+
+	return pool.ranges.allocate(count);
+}
+
+void GeometryArena::resize(Pool& pool, GLuint newCapacity) {
+
+	// Upload through the copy targets so no VAO's element buffer binding is disturbed
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newCapacity * pool.stride, NULL, GL_STATIC_DRAW);
+
+	if (pool.buffer != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, pool.buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)pool.ranges.getCapacity() * pool.stride);
+		glDeleteBuffers(1, &pool.buffer);
+		growCount++;
+	}
+
+	pool.buffer = buffer;
+	pool.ranges.grow(newCapacity);
+
+	// Point the VAOs at the new buffer
+	if (&pool == &indexPool) {
+		for (GLuint format = 0; format < FORMAT_COUNT; format++) {
+			if (vertexArrays[format] != 0)
+				setupVertexArray(format);
+		}
+	} else {
+		setupVertexArray((uint32_t)(&pool - vertexPools));
+	}
+}
+
+void GeometryArena::setupVertexArray(uint32_t format) {
+
+	if (vertexArrays[format] == 0)
+		glGenVertexArrays(1, &vertexArrays[format]);
+
+	glBindVertexArray(vertexArrays[format]);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexPools[format].buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexPool.buffer);
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	if (format == MESH_VERTEX_PACKED) {
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoord));
+	} else {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, texCoord));
+	}
+
+	glBindVertexArray(0);
+}
+
+GeometryArena::Allocation GeometryArena::allocate(uint32_t format, const void* vertices, GLuint vertexCount, const uint32_t* indices, GLuint indexCount) {
+
+	Pool& vertexPool = vertexPools[format];
+
+	Allocation allocation;
+	allocation.format = format;
+	allocation.vertexCount = vertexCount;
+	allocation.indexCount = indexCount;
+	allocation.baseVertex = reserve(vertexPool, vertexCount);
+	allocation.firstIndex = reserve(indexPool, indexCount);
+
+	// The first allocation of a format may not have grown its pool
+	if (vertexArrays[format] == 0)
+		setupVertexArray(format);
+
+	if (vertexCount > 0) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vertexPool.buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.baseVertex * vertexPool.stride, (GLsizeiptr)vertexCount * vertexPool.stride, vertices);
+	}
+	if (indexCount > 0) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, indexPool.buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.firstIndex * sizeof(uint32_t), (GLsizeiptr)indexCount * sizeof(uint32_t), indices);
+	}
+
+	return allocation;
+}
+
+void GeometryArena::free(const Allocation& allocation) {
+	vertexPools[allocation.format].ranges.free(allocation.baseVertex, allocation.vertexCount);
+	indexPool.ranges.free(allocation.firstIndex, allocation.indexCount);
+}
+
+GeometryArena::PoolStats GeometryArena::statsOf(const Pool& pool) {
+	PoolStats stats;
+	stats.capacity = pool.ranges.getCapacity();
+	stats.used = pool.ranges.getUsed();
+	stats.freeRanges = pool.ranges.getFreeRangeCount();
+	stats.largestFree = pool.ranges.getLargestFree();
+	stats.stride = pool.stride;
+	return stats;
+}
+
+void GeometryArena::writeReport(std::ostream& out) const {
+
+	out << "Geometry arena (used / capacity, free ranges, fragmentation):" << std::endl;
+
+	std::streamsize precision = out.precision();
+	auto writePool = [&out, precision](const char* name, const PoolStats& stats) {
+		out << "  " << std::left << std::setw(8) << name << std::right
+			<< std::setw(10) << (size_t)stats.used * stats.stride << " / " << std::setw(10) << (size_t)stats.capacity * stats.stride << " bytes, "
+			<< stats.freeRanges << " free, " << std::fixed << std::setprecision(2) << stats.fragmentation()
+			<< std::defaultfloat << std::setprecision(precision) << std::endl;
+	};
+
+	writePool("float", getVertexStats(MESH_VERTEX_FLOAT));
+	writePool("packed", getVertexStats(MESH_VERTEX_PACKED));
+	writePool("index", getIndexStats());
+	out << "  grown " << growCount << " times" << std::endl;
+}
+
+void GeometryArena::release() {
+
+	for (GLuint format = 0; format < FORMAT_COUNT; format++) {
+		if (vertexArrays[format] != 0)
+			glDeleteVertexArrays(1, &vertexArrays[format]);
+		if (vertexPools[format].buffer != 0)
+			glDeleteBuffers(1, &vertexPools[format].buffer);
+		vertexArrays[format] = 0;
+		vertexPools[format].buffer = 0;
+		vertexPools[format].ranges.reset();
+	}
+
+	if (indexPool.buffer != 0)
+		glDeleteBuffers(1, &indexPool.buffer);
+	indexPool.buffer = 0;
+	indexPool.ranges.reset();
+}
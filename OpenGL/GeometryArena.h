@@ -0,0 +1,159 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include "MeshCache.h"
+#include "GLExtensions.h"
+#include <map>
+#include <ostream>
+#include <set>
+#include <utility>
+
+// Hands out ranges of a linear space (vertices or indices, not bytes).
+// Allocation is best fit; freed ranges merge with free neighbours straight
+// away, so loading and unloading meshes does not leave slivers behind.
+class RangeAllocator {
+
+private:
+
+	std::map<GLuint, GLuint> freeByOffset;	// Offset -> size
+	std::set<std::pair<GLuint, GLuint>> freeBySize;	// (size, offset), for best fit
+	GLuint capacity;
+	GLuint used;
+
+	void insertFree(GLuint offset, GLuint size);
+	void eraseFree(std::map<GLuint, GLuint>::iterator range);
+
+public:
+
+	static const GLuint INVALID = 0xffffffff;
+
+	RangeAllocator() : capacity(0), used(0) {}
+
+	// Returns the offset of count free units, or INVALID if no range is big enough
+	GLuint allocate(GLuint count);
+	void free(GLuint offset, GLuint count);
+
+	// Extends the space to newCapacity units; the new tail is free
+	void grow(GLuint newCapacity);
+
+	void reset();
+
+	GLuint getCapacity() const {
+		return capacity;
+	}
+	GLuint getUsed() const {
+		return used;
+	}
+	GLuint getFreeRangeCount() const {
+		return (GLuint)freeByOffset.size();
+	}
+	GLuint getLargestFree() const {
+		return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+	}
+};
+
+// Shared GPU storage for every StaticMesh: one vertex buffer per vertex
+// format, one index buffer, and one VAO per format that binds them. Meshes
+// only differ by their base vertex and first index, so switching between
+// meshes of the same format needs no vertex state change at all.
+//
+// Buffers start at a fixed size and double when an allocation does not fit,
+// copying the old contents on the GPU. Context thread only.
+class GeometryArena {
+
+public:
+
+	static const GLuint FORMAT_COUNT = 2;	// MESH_VERTEX_FLOAT, MESH_VERTEX_PACKED
+
+	// Basic_shader.vert's per-mesh decode constants. They are current attribute
+	// values rather than arrays, so they are set per draw, not stored in the VAO.
+	static const GLuint DECODE_SCALE_LOCATION = 3;
+	static const GLuint DECODE_OFFSET_LOCATION = 4;
+
+	static const GLuint INITIAL_VERTICES = 1 << 16;	// Per format
+	static const GLuint INITIAL_INDICES = 1 << 18;
+
+	// Where one mesh lives. Offsets are in vertices and indices.
+	struct Allocation {
+		uint32_t format;
+		GLuint baseVertex;
+		GLuint vertexCount;
+		GLuint firstIndex;
+		GLuint indexCount;
+	};
+
+	// Occupancy of one buffer
+	struct PoolStats {
+		GLuint capacity;	// Units the buffer holds
+		GLuint used;
+		GLuint freeRanges;
+		GLuint largestFree;
+		GLuint stride;	// Bytes per unit
+
+		// 0 when the free space is one block, approaching 1 as it splinters
+		float fragmentation() const {
+			GLuint freeUnits = capacity - used;
+			return freeUnits > 0 ? 1.0f - (float)largestFree / freeUnits : 0.0f;
+		}
+	};
+
+private:
+
+	struct Pool {
+		GLuint stride;
+		GLuint initialCapacity;
+		GLuint buffer;
+		RangeAllocator ranges;
+	};
+
+	Pool vertexPools[FORMAT_COUNT];
+	Pool indexPool;
+	GLuint vertexArrays[FORMAT_COUNT];
+	GLuint growCount;
+
+	// Returns the offset of count units in pool, growing it if needed
+	GLuint reserve(Pool& pool, GLuint count);
+	void resize(Pool& pool, GLuint newCapacity);
+	void setupVertexArray(uint32_t format);
+	static PoolStats statsOf(const Pool& pool);
+
+public:
+
+	GeometryArena();
+
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	// Copies a mesh's vertices (in format's layout) and indices into the arena
+	Allocation allocate(uint32_t format, const void* vertices, GLuint vertexCount, const uint32_t* indices, GLuint indexCount);
+
+	// Returns the ranges for reuse; the GPU contents are left as they are
+	void free(const Allocation& allocation);
+
+	// VAO with format's attribute layout and the shared index buffer bound.
+	// Draw with glDrawElementsBaseVertex, offsetting by the allocation.
+	GLuint getVertexArray(uint32_t format) const {
+		return vertexArrays[format];
+	}
+
+	PoolStats getVertexStats(uint32_t format) const {
+		return statsOf(vertexPools[format]);
+	}
+	PoolStats getIndexStats() const {
+		return statsOf(indexPool);
+	}
+	GLuint getGrowCount() const {
+		return growCount;
+	}
+
+	// Capacity, use and fragmentation of each buffer
+	void writeReport(std::ostream& out) const;
+
+	// Frees the GL objects; must run before the context is destroyed, after every model is released
+	void release();
+
+	// The arena every StaticModel allocates from
+	static GeometryArena& shared();
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a. Not cryptographic; used to key on-disk caches to their sources.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& text, uint64_t hash = FNV_OFFSET_BASIS) {
+	return fnv1a64(text.data(), text.size(), hash);
+}
+
+#endif
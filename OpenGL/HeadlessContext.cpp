@@ -0,0 +1,163 @@
+#include "HeadlessContext.h"
+#include <iostream>
+
+#ifdef ENGINE_USE_EGL
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext() : framebuffer(0), colourBuffer(0), depthBuffer(0) {
+#ifdef ENGINE_USE_EGL
+	display = EGL_NO_DISPLAY;
+	context = EGL_NO_CONTEXT;
+#else
+	window = NULL;
+#endif
+}
+
+#ifdef ENGINE_USE_EGL
+
+bool HeadlessContext::createContext() {
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == NULL) {
+		std::cout << "EGL: eglGetPlatformDisplayEXT is not available" << std::endl;
+		return false;
+	}
+
+	display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+		std::cout << "EGL: failed to initialise a surfaceless display" << std::endl;
+		return false;
+	}
+
+	eglBindAPI(EGL_OPENGL_API);
+
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 6,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, configCount > 0 ? config : NULL, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT) {
+		std::cout << "EGL: failed to create a GL 4.6 core context (error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return false;
+	}
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		std::cout << "EGL: failed to make the context current" << std::endl;
+		return false;
+	}
+
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+		return false;
+
+	loadGLExtensions((GLADloadproc)eglGetProcAddress);
+	return true;
+}
+
+void HeadlessContext::destroyContext() {
+	if (display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != EGL_NO_CONTEXT)
+		eglDestroyContext(display, context);
+	eglTerminate(display);
+
+	display = EGL_NO_DISPLAY;
+	context = EGL_NO_CONTEXT;
+}
+
+#else
+
+bool HeadlessContext::createContext() {
+
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	window = glfwCreateWindow(1, 1, "Headless", NULL, NULL);
+	if (window == NULL) {
+		std::cout << "Failed to create hidden GLFW window" << std::endl;
+		return false;
+	}
+
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		return false;
+
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+	return true;
+}
+
+void HeadlessContext::destroyContext() {
+	if (window != NULL)
+		glfwDestroyWindow(window);
+
+	window = NULL;
+	glfwTerminate();
+}
+
+#endif
+
+bool HeadlessContext::create(int width, int height) {
+
+	if (!createContext()) {
+		destroyContext();
+		return false;
+	}
+
+	// Offscreen render target replacing the default framebuffer
+	glGenRenderbuffers(1, &colourBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "Headless framebuffer is incomplete" << std::endl;
+		destroy();
+		return false;
+	}
+
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+void HeadlessContext::destroy() {
+
+	if (framebuffer != 0) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &colourBuffer);
+		glDeleteRenderbuffers(1, &depthBuffer);
+	}
+
+	framebuffer = 0;
+	colourBuffer = 0;
+	depthBuffer = 0;
+
+	destroyContext();
+}
@@ -0,0 +1,50 @@
+#ifndef HEADLESSCONTEXT_H
+#define HEADLESSCONTEXT_H
+
+#include "GLExtensions.h"
+
+#ifdef ENGINE_USE_EGL
+#include <EGL/egl.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+// GL context without a visible window, rendering into an offscreen framebuffer.
+//
+// With ENGINE_USE_EGL defined (Linux build machines) the context comes from a
+// surfaceless EGL display, so it works with Mesa llvmpipe and no X server.
+// Older llvmpipe builds report GL 4.5; run them with
+// MESA_GL_VERSION_OVERRIDE=4.6 MESA_GLSL_VERSION_OVERRIDE=460.
+// Otherwise a hidden GLFW window provides the context.
+class HeadlessContext {
+
+private:
+
+#ifdef ENGINE_USE_EGL
+	EGLDisplay display;
+	EGLContext context;
+#else
+	GLFWwindow* window;
+#endif
+
+	GLuint framebuffer;
+	GLuint colourBuffer;
+	GLuint depthBuffer;
+
+	bool createContext();
+	void destroyContext();
+
+public:
+
+	HeadlessContext();
+
+	// Creates the context, loads GL and binds a width x height framebuffer
+	bool create(int width, int height);
+	void destroy();
+
+	GLuint getFramebuffer() const {
+		return framebuffer;
+	}
+};
+
+#endif
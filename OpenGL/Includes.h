@@ -18,6 +18,29 @@
 #include "Camera.h"
 #include "ShaderLoader.h"
 #include "TextureLoader.h"
+#include "GLStateCache.h"
+#include "UniformTable.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "GeometryArena.h"
+#include "InstanceBuffer.h"
+#include "RenderQueue.h"
+#include "StaticModel.h"
+#include "IndirectRenderer.h"
+#include "AssetLoader.h"
+#include "Light.h"
+#include "SceneGraph.h"
+#include "EntityRegistry.h"
+#include "Systems.h"
+#include "LightClusters.h"
+#include "DeferredRenderer.h"
+#include "CameraBuffer.h"
+#include "ObjectBuffer.h"
+#include "FrameStats.h"
+#include "HeadlessContext.h"
+#include "Benchmark.h"
 
 //namespaces
 using std::string;
@@ -0,0 +1,265 @@
+#include "IndirectRenderer.h"
+#include "FrameStats.h"
+#include "FrustumCuller.h"
+#include "GLStateCache.h"
+#include <algorithm>
+#include <map>
+#include <utility>
+
+IndirectRenderer::IndirectRenderer() :
+	itemCount(0), stale(true), itemBuffer(0), meshBuffer(0), commandBuffer(0), countBuffer(0), cullProgram(0), frustumPlanesLocation(-1) {}
+
+bool IndirectRenderer::isSupported() {
+	return glDispatchCompute != nullptr && glMemoryBarrier != nullptr && glMultiDrawElementsIndirectCount != nullptr;
+}
+
+void IndirectRenderer::setProgram(GLuint program) {
+
+	cullProgram = program;
+	if (program == 0)
+		return;
+
+	cullUniforms.reflect(program);
+	uItemCount = cullUniforms.get<GLuint>("itemCount");
+	frustumPlanesLocation = cullUniforms.getLocation("frustumPlanes[0]");
+	uPixelsPerUnit = cullUniforms.get<GLfloat>("pixelsPerUnit");
+	uLodPixelError = cullUniforms.get<GLfloat>("lodPixelError");
+	uLodHysteresis = cullUniforms.get<GLfloat>("lodHysteresis");
+
+	GLStateCache::shared().useProgram(program);
+	uLodPixelError.set(StaticModel::LOD_PIXEL_ERROR);
+	uLodHysteresis.set(StaticModel::LOD_HYSTERESIS);
+}
+
+void IndirectRenderer::add(const StaticModel& model, GLuint objectIndex) {
+
+	Instance instance;
+	instance.model = &model;
+	instance.objectIndex = objectIndex;
+	instances.push_back(instance);
+
+	bool known = false;
+	for (const ModelState& state : models)
+		known = known || state.model == &model;
+
+	if (!known) {
+		ModelState state;
+		state.model = &model;
+		state.meshCount = 0;
+		state.firstMesh = 0;
+		models.push_back(state);
+	}
+
+	stale = true;
+}
+
+void IndirectRenderer::clear() {
+	instances.clear();
+	models.clear();
+	stale = true;
+}
+
+bool IndirectRenderer::isStale() const {
+
+	if (stale)
+		return true;
+
+	// One check per distinct model, however many instances there are
+	for (const ModelState& state : models) {
+		if (state.model->getMeshes().size() != state.meshCount)
+			return true;
+	}
+	return false;
+}
+
+void IndirectRenderer::rebuild() {
+
+	// Buckets sorted by format, then texture, so VAO changes are as few as possible
+	std::map<std::pair<uint32_t, GLuint>, GLuint> bucketOf;
+	for (ModelState& state : models) {
+		const std::vector<StaticMesh>& meshes = state.model->getMeshes();
+		state.meshCount = meshes.size();
+		for (GLuint i = 0; i < meshes.size(); i++)
+			bucketOf[std::make_pair(meshes[i].geometry.format, state.model->getMeshTexture(i))] = 0;
+	}
+
+	buckets.clear();
+	for (auto& entry : bucketOf) {
+		entry.second = (GLuint)buckets.size();
+
+		Bucket bucket;
+		bucket.format = entry.first.first;
+		bucket.texture = entry.first.second;
+		bucket.firstCommand = 0;
+		bucket.capacity = 0;
+		buckets.push_back(bucket);
+	}
+
+	// One record per mesh of each distinct model, shared by all of its instances
+	std::vector<IndirectMeshRecord> meshRecords;
+	for (ModelState& state : models) {
+
+		const std::vector<StaticMesh>& meshes = state.model->getMeshes();
+		const MeshBounds& modelBounds = state.model->getBounds();
+		state.firstMesh = (GLuint)meshRecords.size();
+
+		// The model changes level as a whole, as in StaticModel::selectLod
+		GLuint levelCount = 0;
+		for (const StaticMesh& mesh : meshes)
+			levelCount = std::max(levelCount, mesh.lodCount);
+
+		for (GLuint i = 0; i < meshes.size(); i++) {
+
+			const StaticMesh& mesh = meshes[i];
+
+			IndirectMeshRecord record = IndirectMeshRecord();
+			record.boundsMin = glm::vec4(mesh.bounds.min, 0.0f);
+			record.boundsMax = glm::vec4(mesh.bounds.max, 0.0f);
+			record.lodSphere = glm::vec4(modelBounds.sphereCentre, modelBounds.sphereRadius);
+			record.decodeScale = mesh.decodeScale;
+			record.decodeOffset = glm::vec4(mesh.decodeOffset, 0.0f);
+			record.baseVertex = mesh.geometry.baseVertex;
+			record.lodCount = levelCount;
+			record.bucket = bucketOf[std::make_pair(mesh.geometry.format, state.model->getMeshTexture(i))];
+
+			for (GLuint level = 0; level < levelCount; level++) {
+				const MeshLod& lod = mesh.lods[std::min(level, mesh.lodCount - 1)];
+				record.lods[level].firstIndex = mesh.geometry.firstIndex + lod.firstIndex;
+				record.lods[level].indexCount = lod.indexCount;
+				record.lods[level].error = 0.0f;
+				for (const StaticMesh& other : meshes)
+					record.lods[level].error = std::max(record.lods[level].error, other.lods[std::min(level, other.lodCount - 1)].error);
+			}
+
+			meshRecords.push_back(record);
+		}
+	}
+
+	// Room in each bucket for every item that could land in it
+	for (const Instance& instance : instances) {
+		for (const ModelState& state : models) {
+			if (state.model != instance.model)
+				continue;
+			for (GLuint i = 0; i < state.meshCount; i++)
+				buckets[meshRecords[state.firstMesh + i].bucket].capacity++;
+		}
+	}
+
+	GLuint commandCount = 0;
+	for (Bucket& bucket : buckets) {
+		bucket.firstCommand = commandCount;
+		commandCount += bucket.capacity;
+	}
+
+	std::vector<IndirectItemRecord> items;
+	for (const Instance& instance : instances) {
+		for (const ModelState& state : models) {
+			if (state.model != instance.model)
+				continue;
+			for (GLuint i = 0; i < state.meshCount; i++) {
+				IndirectItemRecord item;
+				item.objectIndex = instance.objectIndex;
+				item.meshIndex = state.firstMesh + i;
+				item.commandOffset = buckets[meshRecords[item.meshIndex].bucket].firstCommand;
+				item.lod = 0;
+				items.push_back(item);
+			}
+		}
+	}
+
+	itemCount = (GLuint)items.size();
+	zeroCounts.assign(buckets.size(), 0);
+	stale = false;
+
+	if (itemBuffer == 0) {
+		glGenBuffers(1, &itemBuffer);
+		glGenBuffers(1, &meshBuffer);
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &countBuffer);
+	}
+
+	// Sized for at least one record so every binding stays valid
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, itemBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(items.size(), 1) * sizeof(IndirectItemRecord), items.empty() ? NULL : items.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(meshRecords.size(), 1) * sizeof(IndirectMeshRecord), meshRecords.empty() ? NULL : meshRecords.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<GLuint>(commandCount, 1) * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(buckets.size(), 1) * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+}
+
+void IndirectRenderer::cull(const glm::mat4& viewProjection, float pixelsPerUnit) {
+
+	if (cullProgram == 0)
+		return;
+
+	if (isStale())
+		rebuild();
+
+	if (itemCount == 0)
+		return;
+
+	// Every bucket starts the frame empty
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, zeroCounts.size() * sizeof(GLuint), zeroCounts.data());
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ITEM_BINDING, itemBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, meshBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, countBuffer);
+
+	Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+	GLStateCache::shared().useProgram(cullProgram);
+	uItemCount.set(itemCount);
+	glUniform4fv(frustumPlanesLocation, 6, &frustum.planes[0].x);
+	uPixelsPerUnit.set(pixelsPerUnit);
+
+	glDispatchCompute((itemCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	// Commands and counts are read by the draws; levels by the next frame's pass
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void IndirectRenderer::draw() {
+
+	if (cullProgram == 0 || itemCount == 0)
+		return;
+
+	GLStateCache& state = GLStateCache::shared();
+	state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	state.bindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+
+	const GeometryArena& arena = GeometryArena::shared();
+
+	for (GLuint i = 0; i < buckets.size(); i++) {
+
+		const Bucket& bucket = buckets[i];
+
+		state.bindVertexArray(arena.getVertexArray(bucket.format));
+		state.bindTexture(0, GL_TEXTURE_2D, bucket.texture);
+
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT,
+			(const void*)(bucket.firstCommand * sizeof(DrawElementsIndirectCommand)),
+			(GLintptr)(i * sizeof(GLuint)), (GLsizei)bucket.capacity, 0);
+
+		frameStats.drawCalls++;
+	}
+}
+
+void IndirectRenderer::release() {
+
+	if (itemBuffer != 0) {
+		glDeleteBuffers(1, &itemBuffer);
+		glDeleteBuffers(1, &meshBuffer);
+		glDeleteBuffers(1, &commandBuffer);
+		glDeleteBuffers(1, &countBuffer);
+	}
+
+	itemBuffer = 0;
+	meshBuffer = 0;
+	commandBuffer = 0;
+	countBuffer = 0;
+	stale = true;
+}
@@ -0,0 +1,162 @@
+#ifndef INDIRECTRENDERER_H
+#define INDIRECTRENDERER_H
+
+#include "StaticModel.h"
+#include "UniformTable.h"
+#include <vector>
+
+// The records below match Indirect.glsl (std430)
+
+struct IndirectLod {
+	GLuint firstIndex;	// Into the geometry arena's index buffer
+	GLuint indexCount;
+	float error;	// Worst over every mesh of the model
+	GLuint padding;
+};
+
+struct IndirectMeshRecord {
+	glm::vec4 boundsMin;
+	glm::vec4 boundsMax;
+	glm::vec4 lodSphere;	// Whole model's bounding sphere
+	glm::vec4 decodeScale;
+	glm::vec4 decodeOffset;
+	GLuint baseVertex;
+	GLuint lodCount;
+	GLuint bucket;
+	GLuint padding;
+	IndirectLod lods[MESH_MAX_LODS];
+};
+
+static_assert(sizeof(IndirectMeshRecord) == 176, "IndirectMeshRecord must match the std430 IndirectMesh layout");
+
+struct IndirectItemRecord {
+	GLuint objectIndex;
+	GLuint meshIndex;
+	GLuint commandOffset;
+	GLuint lod;
+};
+
+static_assert(sizeof(IndirectItemRecord) == 16, "IndirectItemRecord must match the std430 DrawItem layout");
+
+// The layout glMultiDrawElementsIndirect* reads
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must be tightly packed");
+
+// GPU-driven path for static models (GL 4.6). Every mesh of every added
+// instance becomes a DrawItem in a shader storage buffer. Each frame,
+// Indirect_cull.comp frustum-culls and LOD-selects the items and writes a
+// draw command per survivor into its bucket, one bucket per vertex format and
+// texture; draw() then issues one glMultiDrawElementsIndirectCount per
+// bucket. Transforms come from the ObjectBuffer, so the CPU cost of a frame
+// depends on the number of buckets, not on the number of objects.
+//
+// Draws reach Basic_shader.vert with objectIndex set to INDIRECT_DRAW and
+// find their item through gl_BaseInstance.
+class IndirectRenderer {
+
+private:
+
+	struct Instance {
+		const StaticModel* model;
+		GLuint objectIndex;
+	};
+
+	// Models load asynchronously; a change in mesh count means the items are stale
+	struct ModelState {
+		const StaticModel* model;
+		size_t meshCount;
+		GLuint firstMesh;	// Of the model's records in the mesh buffer
+	};
+
+	struct Bucket {
+		uint32_t format;
+		GLuint texture;
+		GLuint firstCommand;
+		GLuint capacity;	// Items that can land in the bucket
+	};
+
+	std::vector<Instance> instances;
+	std::vector<ModelState> models;
+	std::vector<Bucket> buckets;
+	std::vector<GLuint> zeroCounts;
+	GLuint itemCount;
+	bool stale;
+
+	GLuint itemBuffer;
+	GLuint meshBuffer;
+	GLuint commandBuffer;
+	GLuint countBuffer;
+
+	GLuint cullProgram;
+	UniformTable cullUniforms;
+	Uniform<GLuint> uItemCount;
+	GLint frustumPlanesLocation;
+	Uniform<GLfloat> uPixelsPerUnit;
+	Uniform<GLfloat> uLodPixelError;
+	Uniform<GLfloat> uLodHysteresis;
+
+	bool isStale() const;
+	void rebuild();
+
+public:
+
+	// Matches the bindings in Indirect.glsl and Indirect_cull.comp
+	static const GLuint ITEM_BINDING = 5;
+	static const GLuint MESH_BINDING = 6;
+	static const GLuint COMMAND_BINDING = 7;
+	static const GLuint COUNT_BINDING = 8;
+
+	// Matches local_size_x in Indirect_cull.comp
+	static const GLuint WORKGROUP_SIZE = 64;
+
+	// objectIndex value that tells Basic_shader.vert to read its item
+	static const GLuint INDIRECT_DRAW = 0xffffffff;
+
+	IndirectRenderer();
+
+	IndirectRenderer(const IndirectRenderer&) = delete;
+	IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+	// True if the driver has compute shaders and glMultiDrawElementsIndirectCount
+	static bool isSupported();
+
+	// Indirect_cull.comp, once linked
+	void setProgram(GLuint program);
+
+	bool isReady() const {
+		return cullProgram != 0;
+	}
+
+	// Draws model with the ObjectBuffer record objectIndex. The model can
+	// still be loading; its meshes join as soon as they are uploaded.
+	void add(const StaticModel& model, GLuint objectIndex);
+
+	void clear();
+
+	// Runs the culling pass with its own program. Call once the CameraBuffer
+	// and ObjectBuffer are up to date, before binding the draw program.
+	void cull(const glm::mat4& viewProjection, float pixelsPerUnit);
+
+	// Draws what cull() kept with the bound program, whose objectIndex must
+	// be INDIRECT_DRAW. Textures go to unit 0, as with StaticModel::submit().
+	void draw();
+
+	GLuint getItemCount() const {
+		return itemCount;
+	}
+	GLuint getBucketCount() const {
+		return (GLuint)buckets.size();
+	}
+
+	// Frees the GL buffers; must run before the context is destroyed
+	void release();
+};
+
+#endif
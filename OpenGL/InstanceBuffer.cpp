@@ -0,0 +1,42 @@
+#include "InstanceBuffer.h"
+
+static void setModel(InstanceRecord& record, const glm::mat4& model) {
+
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+	record.model = model;
+	for (int i = 0; i < 3; i++)
+		record.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+}
+
+GLuint InstanceBuffer::add(const glm::mat4& model, const glm::vec4& colour) {
+
+	InstanceRecord record;
+	setModel(record, model);
+	record.colour = colour;
+	return RecordBuffer<InstanceRecord>::add(record);
+}
+
+void InstanceBuffer::setTransform(GLuint index, const glm::mat4& model) {
+
+	if (records[index].model == model)
+		return;
+
+	setModel(records[index], model);
+	markDirty(index);
+}
+
+void InstanceBuffer::setColour(GLuint index, const glm::vec4& colour) {
+	set(index, &InstanceRecord::colour, colour);
+}
+
+void InstanceBuffer::clear() {
+	records.clear();
+	dirty.clear();
+	anyDirty = false;
+}
+
+void InstanceBuffer::bind() const {
+	if (buffer != 0)
+		glBindBufferBase(target, binding, buffer);
+}
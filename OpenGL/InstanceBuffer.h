@@ -0,0 +1,46 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include "RecordBuffer.h"
+#include <glm/glm.hpp>
+
+// One InstanceData record as laid out (std430) in Basic_shader.vert. Like
+// ObjectRecord, with a colour that multiplies the surface's albedo.
+struct InstanceRecord {
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3];
+	glm::vec4 colour;
+};
+
+static_assert(sizeof(InstanceRecord) == 128, "InstanceRecord must match the std430 InstanceData layout");
+
+// Per-instance transforms and colours for StaticModel::drawInstanced(). Each
+// set of copies (every crawler, every light marker) gets its own buffer; they
+// share one binding, so drawInstanced() binds the buffer it draws. Storage
+// grows by doubling like any RecordBuffer, and clear() keeps it, so a set
+// rebuilt every frame does not reallocate once it has reached its size.
+class InstanceBuffer : public RecordBuffer<InstanceRecord> {
+
+public:
+
+	// Matches layout(binding = 9) on InstanceBlock
+	static const GLuint BINDING = 9;
+
+	// objectIndex value that tells Basic_shader.vert to read InstanceBlock[gl_InstanceID]
+	static const GLuint INSTANCED_DRAW = 0xfffffffe;
+
+	InstanceBuffer() : RecordBuffer<InstanceRecord>(GL_SHADER_STORAGE_BUFFER, BINDING) {}
+
+	GLuint add(const glm::mat4& model, const glm::vec4& colour = glm::vec4(1.0f));
+
+	void setTransform(GLuint index, const glm::mat4& model);
+	void setColour(GLuint index, const glm::vec4& colour);
+
+	// Drops every instance; the GPU storage is kept for the next ones
+	void clear();
+
+	// Makes this the buffer InstanceBlock reads
+	void bind() const;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include "LightBuffer.h"
+
+enum class LightType {
+	BULB = 0,
+	DIRECTIONAL = 1,
+	SPOT = 2
+};
+
+// A light is a handle to one record in a LightBuffer. Setters write straight
+// into the CPU mirror so only lights that actually change are re-uploaded.
+class Light {
+
+private:
+
+	LightBuffer* buffer;
+	GLuint index;
+
+public:
+
+	Light(LightBuffer& bufferIn, LightType typeIn, glm::vec3 positionIn, glm::vec3 colourIn, GLfloat intensityIn, glm::vec3 directionIn = glm::vec3(0, -1, 0)) {
+		LightRecord record;
+		record.enabled = 1;
+		record.type = static_cast<GLint>(typeIn);
+		record.position = positionIn;
+		record.direction = directionIn;
+		record.colour = colourIn;
+		record.intensity = intensityIn;
+		record.ambient = glm::vec4(0.1, 0.1, 0.1, 1.0);
+		record.diffuse = glm::vec3(0.0f);
+		record.attenuation = glm::vec3(1.0, 0.09, 0.032f);
+
+		this->buffer = &bufferIn;
+		this->index = bufferIn.add(record);
+		this->setCutOff(12.5, 17.5);
+	}
+
+	void setEnabled(bool enabledIn) {
+		buffer->set(index, &LightRecord::enabled, enabledIn ? 1 : 0);
+	}
+	void setType(LightType typeIn) {
+		buffer->set(index, &LightRecord::type, static_cast<GLint>(typeIn));
+	}
+	void setPosition(glm::vec3 positionIn) {
+		buffer->set(index, &LightRecord::position, positionIn);
+	}
+	void setDirection(glm::vec3 directionIn) {
+		buffer->set(index, &LightRecord::direction, directionIn);
+	}
+	void setColour(glm::vec3 colourIn) {
+		buffer->set(index, &LightRecord::colour, colourIn);
+	}
+	void setIntensity(GLfloat intensityIn) {
+		buffer->set(index, &LightRecord::intensity, intensityIn);
+	}
+	void setAttenuation(glm::vec3 attenuationIn) {
+		buffer->set(index, &LightRecord::attenuation, attenuationIn);
+	}
+	void setDiffusion(glm::vec3 diffuseIn) {
+		buffer->set(index, &LightRecord::diffuse, diffuseIn);
+	}
+	void setCutOff(GLfloat cutOffIn, GLfloat outerCutOffIn) {
+		buffer->set(index, &LightRecord::cutOff, glm::cos(glm::radians(cutOffIn)));
+		buffer->set(index, &LightRecord::outerCutOff, glm::cos(glm::radians(outerCutOffIn)));
+	}
+
+	bool isEnabled() const {
+		return buffer->get(index).enabled != 0;
+	}
+	LightType getType() const {
+		return static_cast<LightType>(buffer->get(index).type);
+	}
+	glm::vec3 getPosition() const {
+		return buffer->get(index).position;
+	}
+	glm::vec3 getDirection() const {
+		return buffer->get(index).direction;
+	}
+	glm::vec3 getColour() const {
+		return buffer->get(index).colour;
+	}
+	GLfloat getIntensity() const {
+		return buffer->get(index).intensity;
+	}
+	glm::vec3 getAttenuation() const {
+		return buffer->get(index).attenuation;
+	}
+	// Culling radius derived from the attenuation; see LightBuffer::range
+	GLfloat getRange() const {
+		return LightBuffer::range(buffer->get(index));
+	}
+	glm::vec3 getDiffusion() const {
+		return buffer->get(index).diffuse;
+	}
+	GLuint getIndex() const {
+		return index;
+	}
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "LightBuffer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+void LightBuffer::upload() {
+
+	bool reallocated = reserve();
+
+	GLuint count = size();
+	if (reallocated || count != uploadedCount) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+		uploadedCount = count;
+	}
+
+	uploadDirty();
+}
+
+GLfloat LightBuffer::range(const LightRecord& record) {
+
+	const GLfloat threshold = 1.0f / 256.0f;
+	GLfloat peak = record.intensity * std::max(record.colour.x, std::max(record.colour.y, record.colour.z));
+
+	// Solve constant + linear * d + quadratic * d^2 = peak / threshold for d
+	GLfloat constant = record.attenuation.x - peak / threshold;
+	GLfloat linear = record.attenuation.y;
+	GLfloat quadratic = record.attenuation.z;
+
+	if (constant >= 0.0f)
+		return 0.0f;
+	if (quadratic > 0.0f)
+		return (-linear + sqrtf(linear * linear - 4.0f * quadratic * constant)) / (2.0f * quadratic);
+	if (linear > 0.0f)
+		return -constant / linear;
+	return FLT_MAX;
+}
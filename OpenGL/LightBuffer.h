@@ -0,0 +1,51 @@
+#ifndef LIGHTBUFFER_H
+#define LIGHTBUFFER_H
+
+#include "RecordBuffer.h"
+#include <glm/glm.hpp>
+
+// One LightSource record as laid out (std430) in Basic_shader.frag
+struct LightRecord {
+	glm::vec3 position;
+	GLfloat intensity;
+	glm::vec3 direction;
+	GLint type;
+	glm::vec3 colour;
+	GLint enabled;
+	glm::vec4 ambient;
+	glm::vec3 diffuse;
+	GLfloat cutOff;
+	glm::vec3 attenuation;
+	GLfloat outerCutOff;
+};
+
+static_assert(sizeof(LightRecord) == 96, "LightRecord must match the std430 LightSource layout");
+
+// CPU mirror of the LightBlock shader storage buffer: a uint light count
+// followed by the unsized Light[] array.
+class LightBuffer : public RecordBuffer<LightRecord> {
+
+private:
+
+	// std430 offset of Light[0]: the uint count is padded to the struct alignment
+	static const GLsizeiptr HEADER_SIZE = 16;
+
+	GLuint uploadedCount;
+
+public:
+
+	// Matches layout(binding = 0) on LightBlock
+	static const GLuint BINDING = 0;
+
+	LightBuffer() : RecordBuffer<LightRecord>(GL_SHADER_STORAGE_BUFFER, BINDING, HEADER_SIZE), uploadedCount(0) {}
+
+	// Uploads the light count and dirty records; call once per frame
+	void upload();
+
+	// Distance at which a bulb or spot light's attenuated contribution drops
+	// below 1/256 in every channel. 0 if it never reaches that; FLT_MAX if
+	// the attenuation never falls off.
+	static GLfloat range(const LightRecord& record);
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include "LightClusters.h"
+#include "Light.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string>
+
+LightClusters::LightClusters() : clusterBuffer(0), indexBuffer(0), indexCapacity(0), cachedProjection(0.0f), nearPlane(0.0f), farPlane(0.0f) {
+	header = ClusterHeader();
+	clusters.resize(CLUSTER_COUNT);
+}
+
+ShaderCache::Defines LightClusters::shaderDefines() {
+	ShaderCache::Defines defines;
+	defines.push_back(std::make_pair(std::string("CLUSTER_X"), std::to_string(CLUSTER_X) + "u"));
+	defines.push_back(std::make_pair(std::string("CLUSTER_Y"), std::to_string(CLUSTER_Y) + "u"));
+	defines.push_back(std::make_pair(std::string("CLUSTER_Z"), std::to_string(CLUSTER_Z) + "u"));
+	return defines;
+}
+
+// View-space point on the frustum at the given NDC xy and positive view depth
+static glm::vec3 unproject(const glm::mat4& projection, GLfloat ndcX, GLfloat ndcY, GLfloat depth) {
+	return glm::vec3(
+		depth * (ndcX + projection[2][0]) / projection[0][0],
+		depth * (ndcY + projection[2][1]) / projection[1][1],
+		-depth);
+}
+
+void LightClusters::rebuildBounds(const glm::mat4& projection) {
+
+	cachedProjection = projection;
+
+	// Recover the clip planes from a glm::perspective style matrix
+	nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+	GLfloat logRatio = logf(farPlane / nearPlane);
+	header.depthScale = CLUSTER_Z / logRatio;
+	header.depthBias = -(CLUSTER_Z * logf(nearPlane)) / logRatio;
+
+	bounds.resize(CLUSTER_COUNT);
+
+	for (GLuint z = 0; z < CLUSTER_Z; z++) {
+
+		GLfloat sliceNear = nearPlane * powf(farPlane / nearPlane, (GLfloat)z / CLUSTER_Z);
+		GLfloat sliceFar = nearPlane * powf(farPlane / nearPlane, (GLfloat)(z + 1) / CLUSTER_Z);
+
+		for (GLuint y = 0; y < CLUSTER_Y; y++) {
+			for (GLuint x = 0; x < CLUSTER_X; x++) {
+
+				GLfloat ndcX[2] = { 2.0f * x / CLUSTER_X - 1.0f, 2.0f * (x + 1) / CLUSTER_X - 1.0f };
+				GLfloat ndcY[2] = { 2.0f * y / CLUSTER_Y - 1.0f, 2.0f * (y + 1) / CLUSTER_Y - 1.0f };
+				GLfloat depths[2] = { sliceNear, sliceFar };
+
+				Bounds& box = bounds[x + CLUSTER_X * (y + CLUSTER_Y * z)];
+				box.min = glm::vec3(FLT_MAX);
+				box.max = glm::vec3(-FLT_MAX);
+
+				for (int corner = 0; corner < 8; corner++) {
+					glm::vec3 point = unproject(projection, ndcX[corner & 1], ndcY[(corner >> 1) & 1], depths[corner >> 2]);
+					box.min = glm::min(box.min, point);
+					box.max = glm::max(box.max, point);
+				}
+			}
+		}
+	}
+}
+
+GLuint LightClusters::sliceOf(GLfloat depth) const {
+	GLfloat slice = logf(std::max(depth, nearPlane)) * header.depthScale + header.depthBias;
+	return std::min((GLuint)std::max(slice, 0.0f), CLUSTER_Z - 1);
+}
+
+void LightClusters::assign(GLuint light, GLuint spot, const glm::vec3& centre, GLfloat radius, const glm::mat4& projection) {
+
+	GLfloat depthMin = -centre.z - radius;
+	GLfloat depthMax = -centre.z + radius;
+	if (depthMax < nearPlane || depthMin > farPlane)
+		return;
+
+	GLuint sliceMin = sliceOf(depthMin);
+	GLuint sliceMax = sliceOf(std::min(depthMax, farPlane));
+
+	// Screen-space tile range from the projected corners of the sphere's AABB;
+	// a sphere crossing the near plane can land anywhere on screen
+	GLuint tileMin[2] = { 0, 0 };
+	GLuint tileMax[2] = { CLUSTER_X - 1, CLUSTER_Y - 1 };
+
+	if (depthMin > nearPlane) {
+		glm::vec2 ndcMin(FLT_MAX);
+		glm::vec2 ndcMax(-FLT_MAX);
+
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 offset(corner & 1 ? radius : -radius, corner & 2 ? radius : -radius, corner & 4 ? radius : -radius);
+			glm::vec4 clip = projection * glm::vec4(centre + offset, 1.0f);
+			glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+
+		if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+			return;
+
+		GLuint dimensions[2] = { CLUSTER_X, CLUSTER_Y };
+		for (int axis = 0; axis < 2; axis++) {
+			GLfloat low = (glm::clamp(ndcMin[axis], -1.0f, 1.0f) * 0.5f + 0.5f) * dimensions[axis];
+			GLfloat high = (glm::clamp(ndcMax[axis], -1.0f, 1.0f) * 0.5f + 0.5f) * dimensions[axis];
+			tileMin[axis] = std::min((GLuint)low, dimensions[axis] - 1);
+			tileMax[axis] = std::min((GLuint)high, dimensions[axis] - 1);
+		}
+	}
+
+	GLfloat radiusSquared = radius * radius;
+
+	for (GLuint z = sliceMin; z <= sliceMax; z++) {
+		for (GLuint y = tileMin[1]; y <= tileMax[1]; y++) {
+			for (GLuint x = tileMin[0]; x <= tileMax[0]; x++) {
+
+				GLuint cluster = x + CLUSTER_X * (y + CLUSTER_Y * z);
+				const Bounds& box = bounds[cluster];
+
+				// Sphere against the cluster's AABB trims the corners of the range
+				glm::vec3 closest = glm::clamp(centre, box.min, box.max) - centre;
+				if (glm::dot(closest, closest) > radiusSquared)
+					continue;
+
+				Assignment assignment;
+				assignment.cluster = cluster;
+				assignment.light = light;
+				assignment.spot = spot;
+				assignments.push_back(assignment);
+			}
+		}
+	}
+}
+
+void LightClusters::update(const LightBuffer& lights, const glm::mat4& view, const glm::mat4& projection) {
+
+	if (bounds.empty() || projection != cachedProjection)
+		rebuildBounds(projection);
+
+	assignments.clear();
+	indices.clear();
+
+	for (GLuint i = 0; i < lights.size(); i++) {
+
+		const LightRecord& record = lights.get(i);
+		if (record.enabled == 0)
+			continue;
+
+		if (record.type == (GLint)LightType::DIRECTIONAL) {
+			indices.push_back(i);
+			continue;
+		}
+
+		GLfloat radius = LightBuffer::range(record);
+		if (radius <= 0.0f)
+			continue;
+
+		GLuint spot = record.type == (GLint)LightType::SPOT ? 1 : 0;
+
+		if (radius == FLT_MAX) {
+			for (GLuint cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+				Assignment assignment;
+				assignment.cluster = cluster;
+				assignment.light = i;
+				assignment.spot = spot;
+				assignments.push_back(assignment);
+			}
+			continue;
+		}
+
+		glm::vec3 centre = glm::vec3(view * glm::vec4(record.position, 1.0f));
+		assign(i, spot, centre, radius, projection);
+	}
+
+	header.globalCount = (GLuint)indices.size();
+
+	// Counting sort of the (cluster, light) pairs into one list per cluster, bulbs before spots
+	for (ClusterRange& cluster : clusters)
+		cluster.counts = 0;
+
+	for (const Assignment& assignment : assignments)
+		clusters[assignment.cluster].counts += assignment.spot ? 0x10000 : 1;
+
+	cursors.resize(CLUSTER_COUNT * 2);
+
+	GLuint offset = header.globalCount;
+	for (GLuint i = 0; i < CLUSTER_COUNT; i++) {
+		ClusterRange& cluster = clusters[i];
+		GLuint bulbs = cluster.counts & 0xFFFF;
+
+		cluster.offset = offset;
+		cursors[i * 2] = offset;
+		cursors[i * 2 + 1] = offset + bulbs;
+		offset += bulbs + (cluster.counts >> 16);
+	}
+
+	indices.resize(offset);
+
+	for (const Assignment& assignment : assignments)
+		indices[cursors[assignment.cluster * 2 + assignment.spot]++] = assignment.light;
+
+	upload();
+}
+
+void LightClusters::upload() {
+
+	if (clusterBuffer == 0) {
+		glGenBuffers(1, &clusterBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterHeader) + CLUSTER_COUNT * sizeof(ClusterRange), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, clusterBuffer);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ClusterHeader), &header);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterHeader), CLUSTER_COUNT * sizeof(ClusterRange), clusters.data());
+
+	// Unsized arrays still need a non-empty buffer behind them
+	GLuint count = std::max<GLuint>(1, (GLuint)indices.size());
+
+	if (indexBuffer == 0 || count > indexCapacity) {
+		if (indexBuffer == 0)
+			glGenBuffers(1, &indexBuffer);
+
+		indexCapacity = std::max<GLuint>(256, std::max<GLuint>(indexCapacity * 2, count));
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, indexCapacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, indexBuffer);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+	if (!indices.empty())
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+}
+
+void LightClusters::release() {
+	if (clusterBuffer != 0)
+		glDeleteBuffers(1, &clusterBuffer);
+	if (indexBuffer != 0)
+		glDeleteBuffers(1, &indexBuffer);
+
+	clusterBuffer = 0;
+	indexBuffer = 0;
+	indexCapacity = 0;
+}
@@ -0,0 +1,101 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include "LightBuffer.h"
+#include "ShaderCache.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Header of the ClusterBlock shader storage buffer (std430), followed by one
+// ClusterRange per cluster
+struct ClusterHeader {
+	GLfloat depthScale;		// slice = log(viewDepth) * depthScale + depthBias
+	GLfloat depthBias;
+	GLuint globalCount;		// Directional lights, at the head of the index list
+	GLuint padding;
+};
+
+static_assert(sizeof(ClusterHeader) == 16, "ClusterHeader must match the std430 ClusterBlock layout");
+
+// A cluster's run in the light index list; uvec2 clusters[] in the shader.
+// Bulbs come first, then spots, so the shader can loop over each type
+// without branching on it.
+struct ClusterRange {
+	GLuint offset;
+	GLuint counts;		// Bulbs in the low 16 bits, spots in the high 16 bits
+};
+
+// Clustered forward light assignment. The view frustum is split into a
+// CLUSTER_X x CLUSTER_Y screen-space grid and CLUSTER_Z exponential depth
+// slices; every light is tested against the clusters its attenuation sphere
+// touches and each cluster gets a compact list of light indices, so a
+// fragment only shades the lights that can actually reach it.
+// Directional lights go in a global list shared by every cluster; bulbs and
+// spots that never fall off are added to every cluster.
+class LightClusters {
+
+private:
+
+	struct Bounds {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	struct Assignment {
+		GLuint cluster;
+		GLuint light;
+		GLuint spot;	// 1 for spots, which follow the bulbs in each list
+	};
+
+	GLuint clusterBuffer;
+	GLuint indexBuffer;
+	GLuint indexCapacity;	// Indices the GPU index buffer can hold
+
+	glm::mat4 cachedProjection;
+	GLfloat nearPlane;
+	GLfloat farPlane;
+	ClusterHeader header;
+	std::vector<Bounds> bounds;		// View-space AABB of every cluster
+
+	std::vector<Assignment> assignments;
+	std::vector<ClusterRange> clusters;
+	std::vector<GLuint> cursors;	// Next free bulb and spot slot of each cluster while filling
+	std::vector<GLuint> indices;
+
+	void rebuildBounds(const glm::mat4& projection);
+	GLuint sliceOf(GLfloat depth) const;
+	void assign(GLuint light, GLuint spot, const glm::vec3& centre, GLfloat radius, const glm::mat4& projection);
+	void upload();
+
+public:
+
+	static const GLuint CLUSTER_X = 16;
+	static const GLuint CLUSTER_Y = 9;
+	static const GLuint CLUSTER_Z = 24;
+	static const GLuint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+	// Match layout(binding = 2) on ClusterBlock and layout(binding = 3) on ClusterLightBlock
+	static const GLuint CLUSTER_BINDING = 2;
+	static const GLuint INDEX_BINDING = 3;
+
+	LightClusters();
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// Grid dimensions for programs that read the clusters
+	static ShaderCache::Defines shaderDefines();
+
+	// Reassigns every enabled light and uploads the lists; call once per
+	// frame after the light buffer is up to date
+	void update(const LightBuffer& lights, const glm::mat4& view, const glm::mat4& projection);
+
+	// Light references across all clusters in the last update
+	GLuint getIndexCount() const {
+		return (GLuint)indices.size();
+	}
+
+	// Frees the GL buffers; must run before the context is destroyed
+	void release();
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL) {}
+
+bool MappedFile::open(const std::string& path) {
+
+	close();
+
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL) {
+		close();
+		return false;
+	}
+
+	bytes = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (bytes == nullptr) {
+		close();
+		return false;
+	}
+
+	length = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+
+	if (bytes != nullptr)
+		UnmapViewOfFile(bytes);
+	if (mappingHandle != NULL)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+
+	bytes = nullptr;
+	length = 0;
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), descriptor(-1) {}
+
+bool MappedFile::open(const std::string& path) {
+
+	close();
+
+	descriptor = ::open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+		close();
+		return false;
+	}
+
+	void* mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+
+	bytes = (const unsigned char*)mapping;
+	length = (size_t)status.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+
+	if (bytes != nullptr)
+		munmap((void*)bytes, length);
+	if (descriptor >= 0)
+		::close(descriptor);
+
+	bytes = nullptr;
+	length = 0;
+	descriptor = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
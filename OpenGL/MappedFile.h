@@ -0,0 +1,45 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are loaded by the OS on
+// first touch, so nothing is copied until the bytes are actually used.
+class MappedFile {
+
+private:
+
+	const unsigned char* bytes;
+	size_t length;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int descriptor;
+#endif
+
+public:
+
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const {
+		return bytes != nullptr;
+	}
+	const unsigned char* data() const {
+		return bytes;
+	}
+	size_t size() const {
+		return length;
+	}
+};
+
+#endif
@@ -0,0 +1,410 @@
+#include "MeshCache.h"
+#include "Hash.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexQuantizer.h"
+#include "WorkerPool.h"
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char MAGIC[4] = { 'M', 'S', 'H', 'C' };
+
+static size_t alignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+glm::vec3 MeshCacheImage::position(uint32_t meshIndex, uint32_t vertex) const {
+
+	const MeshCacheMesh& source = mesh(meshIndex);
+	if (source.vertexFormat != MESH_VERTEX_PACKED)
+		return ((const MeshVertex*)vertexData(meshIndex))[vertex].position;
+
+	glm::vec3 scale(source.positionScale[0], source.positionScale[1], source.positionScale[2]);
+	glm::vec3 offset(source.positionOffset[0], source.positionOffset[1], source.positionOffset[2]);
+	return VertexQuantizer::decodePosition(((const PackedVertex*)vertexData(meshIndex))[vertex], scale, offset);
+}
+
+std::string MeshCache::cachePath(const std::string& sourcePath) {
+	return sourcePath + ".meshcache";
+}
+
+bool MeshCache::validate(const MeshCacheImage& image, uint64_t sourceHash, uint32_t importFlags, uint32_t options) {
+
+	if (image.length < sizeof(MeshCacheHeader))
+		return false;
+
+	const MeshCacheHeader& header = image.header();
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		header.version != VERSION ||
+		header.sourceHash != sourceHash ||
+		header.importFlags != importFlags ||
+		header.options != options ||
+		header.vertexStride != sizeof(MeshVertex))
+		return false;
+
+	if (header.meshOffset + (uint64_t)header.meshCount * sizeof(MeshCacheMesh) > image.length ||
+		header.materialOffset + (uint64_t)header.materialCount * sizeof(MeshCacheMaterial) > image.length)
+		return false;
+
+	// A truncated write must never reach the GPU upload
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+		const MeshCacheMesh& mesh = image.mesh(i);
+		if (mesh.vertexFormat > MESH_VERTEX_PACKED ||
+			mesh.vertexOffset + (uint64_t)mesh.vertexCount * image.vertexStride(i) > image.length ||
+			mesh.indexOffset + (uint64_t)mesh.indexCount * sizeof(uint32_t) > image.length ||
+			(mesh.materialIndex >= header.materialCount && header.materialCount > 0))
+			return false;
+
+		if (mesh.lodCount == 0 || mesh.lodCount > MESH_MAX_LODS || mesh.lods[0].indexCount != mesh.indexCount)
+			return false;
+		for (uint32_t level = 0; level < mesh.lodCount; level++) {
+			if (mesh.indexOffset + ((uint64_t)mesh.lods[level].firstIndex + mesh.lods[level].indexCount) * sizeof(uint32_t) > image.length)
+				return false;
+		}
+
+		// Occluders decode vertices through these indices on the CPU, so an
+		// index past the vertex block would read outside the mapping
+		const uint32_t* indices = image.indices(i);
+		for (uint32_t level = 0; level < mesh.lodCount; level++) {
+			const uint32_t* first = indices + mesh.lods[level].firstIndex;
+			const uint32_t* last = first + mesh.lods[level].indexCount;
+			for (const uint32_t* index = first; index != last; index++) {
+				if (*index >= mesh.vertexCount)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Full mesh plus its simplified levels, built before the file is laid out
+struct ImportedMesh {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;	// Every level back to back
+	uint32_t lodCount;
+	MeshCacheLod lods[MESH_MAX_LODS];
+	MeshOptimizer::CacheStats before;	// Full detail level, as imported
+	MeshOptimizer::CacheStats after;
+	std::vector<PackedVertex> packed;	// Empty unless stored as MESH_VERTEX_PACKED
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+	VertexQuantizer::Error packError;
+	bool packable;
+};
+
+// Lets a piece of a cluster cost this much more ACMR than the cluster as a whole
+static const float OVERDRAW_THRESHOLD = 1.05f;
+
+// Each level aims for half the triangles of the one before. Levels come from
+// the full mesh every time so their error is measured against it; the chain
+// stops early once a level saves little or the mesh is already small.
+static void buildLods(ImportedMesh& mesh) {
+
+	const uint32_t MIN_TRIANGLES = 64;
+	const float MIN_SAVING = 0.8f;
+
+	uint32_t baseCount = (uint32_t)mesh.indices.size();
+	mesh.lodCount = 1;
+	mesh.lods[0].firstIndex = 0;
+	mesh.lods[0].indexCount = baseCount;
+	mesh.lods[0].error = 0.0f;
+
+	while (mesh.lodCount < MESH_MAX_LODS) {
+
+		const MeshCacheLod& previous = mesh.lods[mesh.lodCount - 1];
+		if (previous.indexCount / 3 < MIN_TRIANGLES * 2)
+			break;
+
+		float error = 0.0f;
+		std::vector<uint32_t> simplified = MeshSimplifier::simplify(mesh.vertices.data(), mesh.vertices.size(),
+			mesh.indices.data(), baseCount, previous.indexCount / 6 * 3, error);
+		if (simplified.empty() || simplified.size() > previous.indexCount * MIN_SAVING)
+			break;
+
+		MeshCacheLod& lod = mesh.lods[mesh.lodCount++];
+		lod.firstIndex = (uint32_t)mesh.indices.size();
+		lod.indexCount = (uint32_t)simplified.size();
+		lod.error = std::max(error, previous.error);
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+	}
+}
+
+// Each level is reordered on its own; vertices last, as that renumbers every level
+static void optimizeMesh(ImportedMesh& mesh, uint32_t options) {
+
+	mesh.before = MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.lods[0].indexCount, mesh.vertices.size());
+
+	for (uint32_t level = 0; level < mesh.lodCount; level++) {
+		uint32_t* indices = mesh.indices.data() + mesh.lods[level].firstIndex;
+		size_t indexCount = mesh.lods[level].indexCount;
+		std::vector<uint32_t> clusters;
+
+		if (options & MeshCache::OPTIMIZE_VERTEX_CACHE)
+			MeshOptimizer::optimizeVertexCache(indices, indexCount, mesh.vertices.size(), &clusters);
+		if ((options & MeshCache::OPTIMIZE_VERTEX_CACHE) && (options & MeshCache::OPTIMIZE_OVERDRAW))
+			MeshOptimizer::optimizeOverdraw(indices, indexCount, mesh.vertices.data(), clusters, OVERDRAW_THRESHOLD);
+	}
+
+	if (options & MeshCache::OPTIMIZE_VERTEX_FETCH)
+		MeshOptimizer::optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+	mesh.after = MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.lods[0].indexCount, mesh.vertices.size());
+}
+
+bool MeshCache::import(const std::string& sourcePath, uint64_t sourceHash, uint32_t importFlags, uint32_t options, MeshCacheImage& image) {
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(sourcePath.c_str(), importFlags);
+	if (scene == nullptr || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || scene->mRootNode == nullptr) {
+		std::cout << "MeshCache: Assimp failed to import " << sourcePath << ": " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+
+	std::vector<ImportedMesh> meshes(scene->mNumMeshes);
+
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+
+		const aiMesh* source = scene->mMeshes[i];
+		ImportedMesh& mesh = meshes[i];
+
+		mesh.vertices.resize(source->mNumVertices);
+		for (unsigned int v = 0; v < source->mNumVertices; v++) {
+			const aiVector3D& position = source->mVertices[v];
+			mesh.vertices[v].position = glm::vec3(position.x, position.y, position.z);
+
+			mesh.vertices[v].normal = source->HasNormals() ? glm::vec3(source->mNormals[v].x, source->mNormals[v].y, source->mNormals[v].z) : glm::vec3(0.0f);
+			mesh.vertices[v].texCoord = source->HasTextureCoords(0) ? glm::vec2(source->mTextureCoords[0][v].x, source->mTextureCoords[0][v].y) : glm::vec2(0.0f);
+		}
+
+		// Triangulated on import, so every face has three indices
+		mesh.indices.reserve(source->mNumFaces * 3);
+		for (unsigned int f = 0; f < source->mNumFaces; f++) {
+			const aiFace& face = source->mFaces[f];
+			if (face.mNumIndices != 3)
+				continue;
+			mesh.indices.push_back(face.mIndices[0]);
+			mesh.indices.push_back(face.mIndices[1]);
+			mesh.indices.push_back(face.mIndices[2]);
+		}
+	}
+
+	// Simplification dominates a cold import; meshes are independent
+	WorkerPool::shared().parallelFor(meshes.size(), [&meshes, options](size_t i) {
+		ImportedMesh& mesh = meshes[i];
+		buildLods(mesh);
+		if (options & (OPTIMIZE_VERTEX_CACHE | OPTIMIZE_OVERDRAW | OPTIMIZE_VERTEX_FETCH))
+			optimizeMesh(mesh, options);
+
+		// Packed only if every vertex survives within tolerance
+		mesh.packable = false;
+		if (options & QUANTIZE_VERTICES) {
+			mesh.packable = VertexQuantizer::pack(mesh.vertices, mesh.packed, mesh.positionScale, mesh.positionOffset, mesh.packError);
+			if (!mesh.packable)
+				mesh.packed.clear();
+		}
+	});
+
+	if (options & (OPTIMIZE_VERTEX_CACHE | OPTIMIZE_OVERDRAW | OPTIMIZE_VERTEX_FETCH)) {
+		for (size_t i = 0; i < meshes.size(); i++) {
+			std::cout << "MeshCache: " << sourcePath << " mesh " << i << ": ACMR " << meshes[i].before.acmr << " -> " << meshes[i].after.acmr
+				<< ", ATVR " << meshes[i].before.atvr << " -> " << meshes[i].after.atvr << std::endl;
+		}
+	}
+
+	if (options & QUANTIZE_VERTICES) {
+		size_t floatBytes = 0, storedBytes = 0, packedCount = 0;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			const ImportedMesh& mesh = meshes[i];
+			floatBytes += mesh.vertices.size() * sizeof(MeshVertex);
+			storedBytes += mesh.packable ? mesh.packed.size() * sizeof(PackedVertex) : mesh.vertices.size() * sizeof(MeshVertex);
+			packedCount += mesh.packable;
+
+			std::cout << "MeshCache: " << sourcePath << " mesh " << i << (mesh.packable ? ": packed" : ": kept as float")
+				<< ", error position " << mesh.packError.position << ", normal " << mesh.packError.normal << " deg, texcoord " << mesh.packError.texCoord << std::endl;
+		}
+		std::cout << "MeshCache: " << sourcePath << ": " << packedCount << " of " << meshes.size() << " meshes packed, vertex data "
+			<< floatBytes / 1024 << " KB -> " << storedBytes / 1024 << " KB" << std::endl;
+	}
+
+	// Lay the file out first so every block can be written in place
+	size_t meshOffset = alignUp(sizeof(MeshCacheHeader), 16);
+	size_t materialOffset = alignUp(meshOffset + meshes.size() * sizeof(MeshCacheMesh), 16);
+	size_t cursor = alignUp(materialOffset + scene->mNumMaterials * sizeof(MeshCacheMaterial), 16);
+
+	std::vector<size_t> vertexOffsets(meshes.size());
+	std::vector<size_t> indexOffsets(meshes.size());
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		vertexOffsets[i] = cursor;
+		cursor = alignUp(cursor + meshes[i].vertices.size() * (meshes[i].packable ? sizeof(PackedVertex) : sizeof(MeshVertex)), 16);
+	}
+	for (size_t i = 0; i < meshes.size(); i++) {
+		indexOffsets[i] = cursor;
+		cursor = alignUp(cursor + meshes[i].indices.size() * sizeof(uint32_t), 16);
+	}
+
+	std::vector<unsigned char>& memory = image.memory;
+	memory.assign(cursor, 0);
+
+	MeshCacheHeader* header = (MeshCacheHeader*)memory.data();
+	memcpy(header->magic, MAGIC, sizeof(MAGIC));
+	header->version = VERSION;
+	header->sourceHash = sourceHash;
+	header->importFlags = importFlags;
+	header->options = options;
+	header->vertexStride = sizeof(MeshVertex);
+	header->meshCount = (uint32_t)meshes.size();
+	header->meshOffset = (uint32_t)meshOffset;
+	header->materialCount = scene->mNumMaterials;
+	header->materialOffset = (uint32_t)materialOffset;
+
+	glm::vec3 modelMin(FLT_MAX), modelMax(-FLT_MAX);
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+
+		const ImportedMesh& source = meshes[i];
+		MeshCacheMesh* mesh = (MeshCacheMesh*)(memory.data() + meshOffset) + i;
+
+		if (source.packable && !source.packed.empty())
+			memcpy(memory.data() + vertexOffsets[i], source.packed.data(), source.packed.size() * sizeof(PackedVertex));
+		else if (!source.vertices.empty())
+			memcpy(memory.data() + vertexOffsets[i], source.vertices.data(), source.vertices.size() * sizeof(MeshVertex));
+		if (!source.indices.empty())
+			memcpy(memory.data() + indexOffsets[i], source.indices.data(), source.indices.size() * sizeof(uint32_t));
+
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (const MeshVertex& vertex : source.vertices) {
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+
+		glm::vec3 centre = (boundsMin + boundsMax) * 0.5f;
+		float radius = 0.0f;
+		for (const MeshVertex& vertex : source.vertices)
+			radius = std::max(radius, glm::length(vertex.position - centre));
+
+		mesh->vertexOffset = vertexOffsets[i];
+		mesh->indexOffset = indexOffsets[i];
+		mesh->vertexCount = (uint32_t)source.vertices.size();
+		mesh->indexCount = source.lods[0].indexCount;
+		mesh->materialIndex = scene->mMeshes[i]->mMaterialIndex;
+		for (int axis = 0; axis < 3; axis++) {
+			mesh->boundsMin[axis] = boundsMin[axis];
+			mesh->boundsMax[axis] = boundsMax[axis];
+			mesh->sphereCentre[axis] = centre[axis];
+		}
+		mesh->sphereRadius = radius;
+		mesh->lodCount = source.lodCount;
+		for (uint32_t level = 0; level < source.lodCount; level++)
+			mesh->lods[level] = source.lods[level];
+
+		mesh->vertexFormat = source.packable ? MESH_VERTEX_PACKED : MESH_VERTEX_FLOAT;
+		for (int axis = 0; axis < 3; axis++) {
+			mesh->positionScale[axis] = source.packable ? source.positionScale[axis] : 1.0f;
+			mesh->positionOffset[axis] = source.packable ? source.positionOffset[axis] : 0.0f;
+		}
+
+		modelMin = glm::min(modelMin, boundsMin);
+		modelMax = glm::max(modelMax, boundsMax);
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		header->boundsMin[axis] = modelMin[axis];
+		header->boundsMax[axis] = modelMax[axis];
+	}
+
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+		MeshCacheMaterial* material = (MeshCacheMaterial*)(memory.data() + materialOffset) + i;
+
+		aiString texturePath;
+		if (scene->mMaterials[i]->GetTextureCount(aiTextureType_DIFFUSE) > 0 &&
+			scene->mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == aiReturn_SUCCESS)
+			memcpy(material->diffuseTexture, texturePath.C_Str(), std::min(strlen(texturePath.C_Str()), sizeof(material->diffuseTexture) - 1));
+	}
+
+	image.bytes = memory.data();
+	image.length = memory.size();
+
+	// Best effort: a read-only asset folder just means every start is a cold start
+	std::ofstream out(cachePath(sourcePath), std::ios::binary | std::ios::trunc);
+	if (out)
+		out.write((const char*)memory.data(), memory.size());
+	if (!out)
+		std::cout << "MeshCache: could not write " << cachePath(sourcePath) << std::endl;
+
+	return true;
+}
+
+// Folds every material library the .obj names into hash, so editing a .mtl
+// (and with it the material bindings) invalidates the cache. Like Assimp, the
+// rest of an mtllib line is one path relative to the model's directory.
+static uint64_t hashMaterialLibraries(const std::string& sourcePath, const char* text, size_t size, uint64_t hash) {
+
+	size_t slash = sourcePath.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? std::string() : sourcePath.substr(0, slash + 1);
+
+	size_t lineStart = 0;
+	while (lineStart < size) {
+		const char* end = (const char*)memchr(text + lineStart, '\n', size - lineStart);
+		size_t lineEnd = end ? end - text : size;
+
+		size_t i = lineStart;
+		while (i < lineEnd && (text[i] == ' ' || text[i] == '\t'))
+			i++;
+		if (lineEnd - i > 7 && memcmp(text + i, "mtllib", 6) == 0 && (text[i + 6] == ' ' || text[i + 6] == '\t')) {
+			size_t first = i + 7;
+			size_t last = lineEnd;
+			while (first < last && isspace((unsigned char)text[first]))
+				first++;
+			while (last > first && isspace((unsigned char)text[last - 1]))
+				last--;
+
+			std::string name(text + first, last - first);
+			hash = fnv1a64(name, hash);
+
+			// A missing library still keys on its name, so creating it later misses too
+			MappedFile library;
+			if (library.open(directory + name))
+				hash = fnv1a64(library.data(), library.size(), hash);
+		}
+
+		lineStart = lineEnd + 1;
+	}
+
+	return hash;
+}
+
+bool MeshCache::load(const std::string& sourcePath, uint32_t importFlags, uint32_t options, MeshCacheImage& image) {
+
+	MappedFile source;
+	if (!source.open(sourcePath)) {
+		std::cout << "MeshCache: cannot open " << sourcePath << std::endl;
+		return false;
+	}
+
+	uint64_t sourceHash = fnv1a64(source.data(), source.size());
+	sourceHash = hashMaterialLibraries(sourcePath, (const char*)source.data(), source.size(), sourceHash);
+	source.close();
+
+	if (image.file.open(cachePath(sourcePath))) {
+		image.bytes = image.file.data();
+		image.length = image.file.size();
+
+		if (validate(image, sourceHash, importFlags, options))
+			return true;
+
+		image.file.close();
+		image.bytes = nullptr;
+		image.length = 0;
+	}
+
+	return import(sourcePath, sourceHash, importFlags, options, image);
+}
@@ -0,0 +1,169 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "MappedFile.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Interleaved vertex layout stored in the cache and fed to Basic_shader.vert
+struct MeshVertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+static_assert(sizeof(MeshVertex) == 32, "MeshVertex must be tightly packed");
+
+// Compact layout, decoded by Basic_shader.vert: position as unorm16 within the
+// mesh AABB (w unused), octahedral normal as 2 x snorm16, texcoord as half floats
+struct PackedVertex {
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texCoord[2];
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be tightly packed");
+
+// MeshCacheMesh::vertexFormat
+const uint32_t MESH_VERTEX_FLOAT = 0;	// MeshVertex
+const uint32_t MESH_VERTEX_PACKED = 1;	// PackedVertex
+
+// Levels of detail per mesh, the full mesh included
+const uint32_t MESH_MAX_LODS = 5;
+
+// On-disk layout of a .meshcache file:
+//   MeshCacheHeader
+//   MeshCacheMesh[meshCount]
+//   MeshCacheMaterial[materialCount]
+//   vertex data (16-byte aligned, one block per mesh)
+//   index data (uint32, one block per mesh holding every level of detail)
+// All offsets are in bytes from the start of the file.
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;	// The .obj and the material libraries it names
+	uint32_t importFlags;
+	uint32_t options;	// MeshCache::OPTIMIZE_* stages the data went through
+	uint32_t vertexStride;
+	uint32_t meshCount;
+	uint32_t meshOffset;
+	uint32_t materialCount;
+	uint32_t materialOffset;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+// One simplified index list over the mesh's (shared) vertices
+struct MeshCacheLod {
+	uint32_t firstIndex;	// Into the mesh's index block
+	uint32_t indexCount;
+	float error;	// Largest distance from the full mesh, in model units
+};
+
+struct MeshCacheMesh {
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;	// Full detail; the same as lods[0].indexCount
+	uint32_t materialIndex;
+	float boundsMin[3];
+	float boundsMax[3];
+	float sphereCentre[3];
+	float sphereRadius;
+	uint32_t lodCount;
+	MeshCacheLod lods[MESH_MAX_LODS];	// Increasingly coarse, lods[0] being the full mesh
+	uint32_t vertexFormat;
+	float positionScale[3];	// Packed position = offset + unorm * scale
+	float positionOffset[3];
+};
+
+struct MeshCacheMaterial {
+	char diffuseTexture[260];	// Relative to the model's directory, empty if none
+};
+
+// A cache file held in memory: either mapped straight from disk (warm start)
+// or built from a fresh Assimp import (cold start).
+class MeshCacheImage {
+
+private:
+
+	MappedFile file;
+	std::vector<unsigned char> memory;
+	const unsigned char* bytes;
+	size_t length;
+
+	friend class MeshCache;
+
+public:
+
+	MeshCacheImage() : bytes(nullptr), length(0) {}
+
+	MeshCacheImage(const MeshCacheImage&) = delete;
+	MeshCacheImage& operator=(const MeshCacheImage&) = delete;
+
+	bool isMapped() const {
+		return file.isOpen();
+	}
+
+	const MeshCacheHeader& header() const {
+		return *(const MeshCacheHeader*)bytes;
+	}
+	const MeshCacheMesh& mesh(uint32_t index) const {
+		return ((const MeshCacheMesh*)(bytes + header().meshOffset))[index];
+	}
+	const MeshCacheMaterial& material(uint32_t index) const {
+		return ((const MeshCacheMaterial*)(bytes + header().materialOffset))[index];
+	}
+	// MeshVertex or PackedVertex, depending on the mesh's vertexFormat
+	const void* vertexData(uint32_t meshIndex) const {
+		return bytes + mesh(meshIndex).vertexOffset;
+	}
+	uint32_t vertexStride(uint32_t meshIndex) const {
+		return mesh(meshIndex).vertexFormat == MESH_VERTEX_PACKED ? sizeof(PackedVertex) : sizeof(MeshVertex);
+	}
+
+	// Decoded model-space position, whatever the format
+	glm::vec3 position(uint32_t meshIndex, uint32_t vertex) const;
+	const uint32_t* indices(uint32_t meshIndex) const {
+		return (const uint32_t*)(bytes + mesh(meshIndex).indexOffset);
+	}
+};
+
+// Versioned binary cache written next to each model (<model>.meshcache).
+// Caches are keyed by a hash of the source file, the material libraries it
+// names and the import flags; any mismatch falls back to Assimp and rewrites
+// the cache.
+class MeshCache {
+
+private:
+
+	static bool validate(const MeshCacheImage& image, uint64_t sourceHash, uint32_t importFlags, uint32_t options);
+	static bool import(const std::string& sourcePath, uint64_t sourceHash, uint32_t importFlags, uint32_t options, MeshCacheImage& image);
+
+public:
+
+	// Bump whenever the file layout or the import pipeline changes
+	static const uint32_t VERSION = 5;
+
+	// Reorder triangles for the post-transform vertex cache (Tipsify)
+	static const uint32_t OPTIMIZE_VERTEX_CACHE = 1 << 0;
+
+	// Then draw outward-facing clusters first, for early-z; needs OPTIMIZE_VERTEX_CACHE
+	static const uint32_t OPTIMIZE_OVERDRAW = 1 << 1;
+
+	// Renumber vertices in order of first use
+	static const uint32_t OPTIMIZE_VERTEX_FETCH = 1 << 2;
+
+	// Store meshes as PackedVertex wherever the error stays within VertexQuantizer's tolerances
+	static const uint32_t QUANTIZE_VERTICES = 1 << 3;
+
+	static std::string cachePath(const std::string& sourcePath);
+
+	// Caches are keyed by importFlags and options as well as the source; a
+	// cold import with any OPTIMIZE_* option reports ACMR/ATVR per mesh
+	static bool load(const std::string& sourcePath, uint32_t importFlags, uint32_t options, MeshCacheImage& image);
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+// FIFO cache simulated with timestamps: a vertex is resident while fewer than
+// CACHE_SIZE misses have happened since it was loaded
+class CacheSimulator {
+
+private:
+
+	std::vector<uint32_t> loadedAt;
+	uint32_t time;
+
+public:
+
+	explicit CacheSimulator(size_t vertexCount) : loadedAt(vertexCount, 0), time(MeshOptimizer::CACHE_SIZE + 1) {}
+
+	// Returns true on a miss
+	bool access(uint32_t vertex) {
+		if (time - loadedAt[vertex] <= MeshOptimizer::CACHE_SIZE)
+			return false;
+		loadedAt[vertex] = time++;
+		return true;
+	}
+
+	void flush() {
+		time += MeshOptimizer::CACHE_SIZE + 1;
+	}
+};
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+
+	CacheSimulator cache(vertexCount);
+	std::vector<unsigned char> used(vertexCount, 0);
+	size_t misses = 0;
+	size_t usedCount = 0;
+
+	for (size_t i = 0; i < indexCount; i++) {
+		misses += cache.access(indices[i]);
+		if (!used[indices[i]]) {
+			used[indices[i]] = 1;
+			usedCount++;
+		}
+	}
+
+	CacheStats stats;
+	stats.acmr = indexCount >= 3 ? (float)misses / (indexCount / 3) : 0.0f;
+	stats.atvr = usedCount > 0 ? (float)misses / usedCount : 0.0f;
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters) {
+
+	size_t triangleCount = indexCount / 3;
+	if (clusters != nullptr)
+		clusters->clear();
+	if (triangleCount == 0)
+		return;
+
+	// Triangles around each vertex, and how many of them are still to be emitted
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyStart[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyStart[v + 1] += adjacencyStart[v];
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> live(vertexCount);
+	{
+		std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+		for (size_t v = 0; v < vertexCount; v++)
+			live[v] = adjacencyStart[v + 1] - adjacencyStart[v];
+	}
+
+	std::vector<uint32_t> loadedAt(vertexCount, 0);
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t time = CACHE_SIZE + 1;
+	size_t cursor = 0;	// Next vertex to try once the dead-end stack runs dry
+	int64_t fan = 0;
+	bool jumped = true;	// The next triangle starts a new cluster
+
+	while (fan >= 0) {
+
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++) {
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+
+			if (jumped && clusters != nullptr)
+				clusters->push_back((uint32_t)(output.size() / 3));
+			jumped = false;
+
+			for (int corner = 0; corner < 3; corner++) {
+				uint32_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				if (time - loadedAt[vertex] > CACHE_SIZE)
+					loadedAt[vertex] = time++;
+			}
+			emitted[triangle] = 1;
+		}
+
+		// Next fan: the candidate that will still be cached after its own triangles, oldest first
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t vertex : candidates) {
+			if (live[vertex] == 0)
+				continue;
+			int64_t priority = 0;
+			if (time - loadedAt[vertex] + 2 * live[vertex] <= CACHE_SIZE)
+				priority = time - loadedAt[vertex];
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		// Dead end: back up to a recently used vertex, or failing that any vertex with work left
+		if (next < 0) {
+			jumped = true;
+			while (!deadEnds.empty() && next < 0) {
+				uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (live[vertex] > 0)
+					next = vertex;
+			}
+			while (next < 0 && cursor < vertexCount) {
+				if (live[cursor] > 0)
+					next = (int64_t)cursor;
+				cursor++;
+			}
+		}
+
+		fan = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, const std::vector<uint32_t>& clusters, float threshold) {
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || clusters.empty())
+		return;
+
+	size_t vertexCount = 0;
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		vertexCount = std::max(vertexCount, (size_t)indices[i] + 1);
+
+	// Split each cluster wherever the piece so far is already within threshold of the cluster's ACMR
+	std::vector<uint32_t> pieces;
+	CacheSimulator cache(vertexCount);
+
+	for (size_t c = 0; c < clusters.size(); c++) {
+		size_t first = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		cache.flush();
+		size_t clusterMisses = 0;
+		for (size_t t = first; t < end; t++) {
+			for (int corner = 0; corner < 3; corner++)
+				clusterMisses += cache.access(indices[t * 3 + corner]);
+		}
+		float clusterAcmr = (float)clusterMisses / (end - first);
+
+		cache.flush();
+		size_t start = first;
+		size_t misses = 0;
+		pieces.push_back((uint32_t)first);
+		for (size_t t = first; t + 1 < end; t++) {
+			for (int corner = 0; corner < 3; corner++)
+				misses += cache.access(indices[t * 3 + corner]);
+
+			if ((float)misses / (t + 1 - start) <= clusterAcmr * threshold) {
+				cache.flush();
+				start = t + 1;
+				misses = 0;
+				pieces.push_back((uint32_t)start);
+			}
+		}
+	}
+
+	// Area-weighted centroid and normal per piece, and the centroid of the whole mesh
+	struct Piece {
+		uint32_t first;
+		uint32_t end;
+		float sortKey;
+	};
+	std::vector<Piece> order(pieces.size());
+	std::vector<glm::vec3> centroids(pieces.size());
+	std::vector<glm::vec3> normals(pieces.size());
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t p = 0; p < pieces.size(); p++) {
+		order[p].first = pieces[p];
+		order[p].end = p + 1 < pieces.size() ? pieces[p + 1] : (uint32_t)triangleCount;
+
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = order[p].first; t < order[p].end; t++) {
+			const glm::vec3& a = vertices[indices[t * 3]].position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& c = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 cross = glm::cross(b - a, c - a);
+			float weight = glm::length(cross);
+			centroid += (a + b + c) * (weight / 3.0f);
+			normal += cross;
+			area += weight;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids[p] = area > 0.0f ? centroid / area : vertices[indices[order[p].first * 3]].position;
+		normals[p] = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Pieces facing away from the middle of the mesh are the ones likely to be in front
+	for (size_t p = 0; p < pieces.size(); p++)
+		order[p].sortKey = glm::dot(centroids[p] - meshCentroid, normals[p]);
+	std::stable_sort(order.begin(), order.end(), [](const Piece& x, const Piece& y) { return x.sortKey > y.sortKey; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (const Piece& piece : order)
+		output.insert(output.end(), indices + piece.first * 3, indices + piece.end * 3);
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<MeshVertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = (uint32_t)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
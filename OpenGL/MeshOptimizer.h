@@ -0,0 +1,40 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "MeshCache.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index and vertex reordering for the GPU's post-transform cache, early-z and
+// vertex fetch, after Sander, Nehab and Barczak, "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw" (2007). Only the order changes: the
+// same triangles, with the same winding, are drawn.
+class MeshOptimizer {
+
+public:
+
+	// Entries in the simulated FIFO post-transform cache
+	static const uint32_t CACHE_SIZE = 16;
+
+	struct CacheStats {
+		float acmr;	// Average cache miss ratio: vertex shader runs per triangle (0.5 to 3)
+		float atvr;	// Average transform to vertex ratio: runs per vertex used (1 is ideal)
+	};
+
+	static CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// Tipsify: fans triangles around vertices still in the cache. If clusters is
+	// given it receives the first triangle of every run between dead ends.
+	static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters);
+
+	// Splits the clusters from optimizeVertexCache further while each piece's ACMR
+	// stays within threshold of its cluster's, then draws outward-facing pieces first
+	static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, const std::vector<uint32_t>& clusters, float threshold);
+
+	// Renumbers vertices in order of first use and drops unused ones. Every
+	// level of detail sits in indices, so they all stay valid.
+	static void optimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+};
+
+#endif
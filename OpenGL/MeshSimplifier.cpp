@@ -0,0 +1,303 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Open edges count this many times more than a surface plane of the same size
+static const double BORDER_WEIGHT = 10.0;
+
+// A collapse may tilt a triangle by at most acos(0.25), about 75 degrees
+static const double MAX_NORMAL_TILT = 0.25;
+
+// Symmetric 4x4 error matrix sum(w * p p^T) for planes p, plus the summed weight
+struct Quadric {
+	double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+	double weight;
+
+	Quadric() : xx(0), xy(0), xz(0), xw(0), yy(0), yz(0), yw(0), zz(0), zw(0), ww(0), weight(0) {}
+
+	// Plane n.p + d = 0 with unit normal n
+	static Quadric fromPlane(const glm::vec3& n, double d, double w) {
+		Quadric q;
+		q.xx = w * n.x * n.x; q.xy = w * n.x * n.y; q.xz = w * n.x * n.z; q.xw = w * n.x * d;
+		q.yy = w * n.y * n.y; q.yz = w * n.y * n.z; q.yw = w * n.y * d;
+		q.zz = w * n.z * n.z; q.zw = w * n.z * d;
+		q.ww = w * d * d;
+		q.weight = w;
+		return q;
+	}
+
+	void add(const Quadric& q) {
+		xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+		yy += q.yy; yz += q.yz; yw += q.yw;
+		zz += q.zz; zw += q.zw;
+		ww += q.ww;
+		weight += q.weight;
+	}
+
+	// Weighted sum of squared distances from p to the planes
+	double evaluate(const glm::vec3& p) const {
+		double rx = xx * p.x + xy * p.y + xz * p.z + xw;
+		double ry = xy * p.x + yy * p.y + yz * p.z + yw;
+		double rz = xz * p.x + yz * p.y + zz * p.z + zw;
+		double rw = xw * p.x + yw * p.y + zw * p.z + ww;
+		return std::fabs(rx * p.x + ry * p.y + rz * p.z + rw);
+	}
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	double error;	// Mean squared distance
+};
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float& error) {
+
+	error = 0.0f;
+	std::vector<uint32_t> result(indices, indices + indexCount);
+	if (indexCount <= targetIndexCount)
+		return result;
+
+	// Weld vertices that share a position into one collapse site ("position")
+	std::vector<uint32_t> positionOf(vertexCount);
+	std::vector<uint32_t> firstCopy;	// Vertex list per position, chained through nextCopy
+	std::vector<uint32_t> nextCopy(vertexCount, UINT32_MAX);
+	std::vector<glm::vec3> positions;
+	{
+		std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			const glm::vec3& p = vertices[v].position;
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			uint64_t hash = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+
+			std::vector<uint32_t>& bucket = buckets[hash];
+			uint32_t found = UINT32_MAX;
+			for (uint32_t candidate : bucket) {
+				if (positions[candidate] == p) {
+					found = candidate;
+					break;
+				}
+			}
+			if (found == UINT32_MAX) {
+				found = (uint32_t)positions.size();
+				positions.push_back(p);
+				firstCopy.push_back(UINT32_MAX);
+				bucket.push_back(found);
+			}
+
+			positionOf[v] = found;
+			nextCopy[v] = firstCopy[found];
+			firstCopy[found] = v;
+		}
+	}
+
+	size_t positionCount = positions.size();
+	std::vector<Quadric> quadrics(positionCount);
+
+	// Every triangle adds its plane, weighted by area, to its three corners
+	std::vector<uint64_t> edges;
+	edges.reserve(indexCount);
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t corner[3] = { positionOf[indices[i]], positionOf[indices[i + 1]], positionOf[indices[i + 2]] };
+		glm::vec3 cross = glm::cross(positions[corner[1]] - positions[corner[0]], positions[corner[2]] - positions[corner[0]]);
+		float length = glm::length(cross);
+		if (length == 0.0f)
+			continue;
+
+		glm::vec3 normal = cross / length;
+		Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, positions[corner[0]]), length * 0.5);
+		for (int c = 0; c < 3; c++) {
+			quadrics[corner[c]].add(plane);
+			edges.push_back(edgeKey(corner[c], corner[(c + 1) % 3]));
+		}
+	}
+
+	// Edges used by a single triangle lie on an open border; hold them in place
+	// with a plane through the edge, perpendicular to the triangle
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t corner[3] = { positionOf[indices[i]], positionOf[indices[i + 1]], positionOf[indices[i + 2]] };
+		glm::vec3 faceNormal = glm::cross(positions[corner[1]] - positions[corner[0]], positions[corner[2]] - positions[corner[0]]);
+		if (glm::length(faceNormal) == 0.0f)
+			continue;
+
+		for (int c = 0; c < 3; c++) {
+			uint32_t a = corner[c], b = corner[(c + 1) % 3];
+			uint64_t key = edgeKey(a, b);
+			std::pair<std::vector<uint64_t>::iterator, std::vector<uint64_t>::iterator> range = std::equal_range(edges.begin(), edges.end(), key);
+			if (range.second - range.first != 1)
+				continue;
+
+			glm::vec3 edge = positions[b] - positions[a];
+			glm::vec3 normal = glm::cross(edge, faceNormal);
+			float length = glm::length(normal);
+			if (length == 0.0f)
+				continue;
+			normal /= length;
+
+			Quadric border = Quadric::fromPlane(normal, -glm::dot(normal, positions[a]), glm::dot(edge, edge) * BORDER_WEIGHT);
+			quadrics[a].add(border);
+			quadrics[b].add(border);
+		}
+	}
+
+	std::vector<uint32_t> mergedInto(positionCount);
+	for (uint32_t p = 0; p < positionCount; p++)
+		mergedInto[p] = p;
+
+	std::vector<uint32_t> triangles;	// Positions, three per live triangle
+	for (size_t i = 0; i < indexCount; i++)
+		triangles.push_back(positionOf[indices[i]]);
+
+	size_t targetTriangles = targetIndexCount / 3;
+	size_t triangleCount = indexCount / 3;
+	double maxError = 0.0;
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> adjacencyStart;
+	std::vector<uint32_t> adjacency;
+	std::vector<unsigned char> locked(positionCount);
+
+	while (triangleCount > targetTriangles) {
+
+		// Cheapest direction for every edge of the current mesh
+		edges.clear();
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			for (int c = 0; c < 3; c++)
+				edges.push_back(edgeKey(triangles[i + c], triangles[i + (c + 1) % 3]));
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		collapses.clear();
+		for (uint64_t key : edges) {
+			uint32_t a = (uint32_t)(key >> 32), b = (uint32_t)key;
+			Quadric merged = quadrics[a];
+			merged.add(quadrics[b]);
+
+			double toB = merged.evaluate(positions[b]);
+			double toA = merged.evaluate(positions[a]);
+			Collapse collapse;
+			collapse.from = toB <= toA ? a : b;
+			collapse.to = toB <= toA ? b : a;
+			collapse.error = std::min(toA, toB) / std::max(merged.weight, 1e-30);
+			collapses.push_back(collapse);
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+		// Triangles around each position
+		adjacencyStart.assign(positionCount + 1, 0);
+		for (uint32_t p : triangles)
+			adjacencyStart[p + 1]++;
+		for (size_t p = 0; p < positionCount; p++)
+			adjacencyStart[p + 1] += adjacencyStart[p];
+		adjacency.resize(triangles.size());
+		{
+			std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (size_t i = 0; i < triangles.size(); i++)
+				adjacency[fill[triangles[i]]++] = (uint32_t)(i / 3);
+		}
+
+		// Collapse the cheapest edges whose ends have not moved this pass
+		std::fill(locked.begin(), locked.end(), 0);
+		size_t collapsed = 0;
+
+		for (const Collapse& collapse : collapses) {
+
+			if (triangleCount <= targetTriangles)
+				break;
+			if (locked[collapse.from] || locked[collapse.to])
+				continue;
+
+			// Reject collapses that fold a surviving triangle over
+			bool folds = false;
+			size_t removed = 0;
+			for (uint32_t a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1] && !folds; a++) {
+				uint32_t* corner = &triangles[adjacency[a] * 3];
+				glm::vec3 before[3], after[3];
+				bool degenerate = false;
+				for (int c = 0; c < 3; c++) {
+					uint32_t p = mergedInto[corner[c]];
+					degenerate |= p == collapse.to;
+					before[c] = positions[p];
+					after[c] = p == collapse.from ? positions[collapse.to] : positions[p];
+				}
+				if (degenerate) {
+					removed++;
+					continue;
+				}
+
+				glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				folds = glm::dot(normalBefore, normalAfter) <= MAX_NORMAL_TILT * glm::length(normalBefore) * glm::length(normalAfter);
+			}
+			if (folds)
+				continue;
+
+			mergedInto[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			locked[collapse.from] = 1;
+			locked[collapse.to] = 1;
+
+			triangleCount -= std::min(removed, triangleCount);
+			maxError = std::max(maxError, collapse.error);
+			collapsed++;
+		}
+
+		if (collapsed == 0)
+			break;
+
+		// Apply the merges and drop triangles that lost an edge
+		size_t write = 0;
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			uint32_t a = mergedInto[triangles[i]], b = mergedInto[triangles[i + 1]], c = mergedInto[triangles[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			triangles[write++] = a;
+			triangles[write++] = b;
+			triangles[write++] = c;
+		}
+		triangles.resize(write);
+		triangleCount = write / 3;
+
+		for (uint32_t p = 0; p < positionCount; p++)
+			mergedInto[p] = mergedInto[mergedInto[p]];
+	}
+
+	// Back to vertex indices: corners keep their vertex unless its position was
+	// merged away, in which case the new position's copy closest in normal is used
+	result.clear();
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t corner[3];
+		for (int c = 0; c < 3; c++)
+			corner[c] = mergedInto[positionOf[indices[i + c]]];
+		if (corner[0] == corner[1] || corner[1] == corner[2] || corner[2] == corner[0])
+			continue;
+
+		for (int c = 0; c < 3; c++) {
+			uint32_t vertex = indices[i + c];
+			if (positionOf[vertex] != corner[c]) {
+				uint32_t best = firstCopy[corner[c]];
+				float bestDot = -2.0f;
+				for (uint32_t copy = best; copy != UINT32_MAX; copy = nextCopy[copy]) {
+					float similarity = glm::dot(vertices[copy].normal, vertices[vertex].normal);
+					if (similarity > bestDot) {
+						bestDot = similarity;
+						best = copy;
+					}
+				}
+				vertex = best;
+			}
+			result.push_back(vertex);
+		}
+	}
+
+	error = (float)std::sqrt(maxError);
+	return result;
+}
@@ -0,0 +1,27 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include "MeshCache.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quadric error metric edge-collapse simplification (Garland and Heckbert).
+//
+// Vertices are never moved or created: each collapse merges a vertex into one
+// of its neighbours, so a simplified level is only a new index list over the
+// original vertex buffer and every level of a mesh can share one buffer.
+// Vertices are welded by position first, so UV and normal seams do not tear
+// open; a corner that loses its vertex takes the neighbour's copy with the
+// closest normal. Open borders carry extra quadrics to keep the outline.
+class MeshSimplifier {
+
+public:
+
+	// Collapses edges in order of increasing error until at most targetIndexCount
+	// indices remain or no collapse is left that would not fold a triangle over.
+	// error receives the largest collapse error as a distance in model units.
+	static std::vector<uint32_t> simplify(const MeshVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float& error);
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "MipGenerator.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPGENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	// 8-bit sRGB to linear, and linear (quantised to 12 bits) back to 8-bit sRGB
+	struct SrgbTables {
+
+		static const int LINEAR_STEPS = 4096;
+
+		float toLinear[256];
+		uint8_t toSrgb[LINEAR_STEPS];
+
+		SrgbTables() {
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < LINEAR_STEPS; i++) {
+				float l = i / float(LINEAR_STEPS - 1);
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+				toSrgb[i] = (uint8_t)(c * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SrgbTables& srgbTables() {
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	// Quarter of a sum of four linear values, as a toSrgb index
+	const float INDEX_SCALE = (SrgbTables::LINEAR_STEPS - 1) * 0.25f;
+
+	// Averages four RGBA8 texels, decoding RGB from sRGB first
+	inline void averageSrgb(const uint8_t* a, const uint8_t* b, const uint8_t* c, const uint8_t* d, uint8_t* out, const SrgbTables& tables) {
+
+		const float* lin = tables.toLinear;
+
+		for (int channel = 0; channel < 3; channel++) {
+			float sum = lin[a[channel]] + lin[b[channel]] + lin[c[channel]] + lin[d[channel]];
+			out[channel] = tables.toSrgb[(int)(sum * INDEX_SCALE + 0.5f)];
+		}
+		out[3] = (uint8_t)((a[3] + b[3] + c[3] + d[3] + 2) >> 2);
+	}
+
+	inline void averageLinear(const uint8_t* a, const uint8_t* b, const uint8_t* c, const uint8_t* d, uint8_t* out) {
+		for (int channel = 0; channel < 4; channel++)
+			out[channel] = (uint8_t)((a[channel] + b[channel] + c[channel] + d[channel] + 2) >> 2);
+	}
+
+#ifdef MIPGENERATOR_SSE2
+	// One channel of four output texels, averaged in linear light, as toSrgb
+	// indices. top and bottom are the source rows under the first output texel.
+	inline __m128i averageSrgb4(const uint8_t* top, const uint8_t* bottom, int channel, const float* lin) {
+
+		const uint8_t* t = top + channel;
+		const uint8_t* b = bottom + channel;
+
+		// SSE2 has no gather, so the decode is the only per-texel step
+		__m128 sum = _mm_set_ps(lin[t[24]], lin[t[16]], lin[t[8]], lin[t[0]]);
+		sum = _mm_add_ps(sum, _mm_set_ps(lin[t[28]], lin[t[20]], lin[t[12]], lin[t[4]]));
+		sum = _mm_add_ps(sum, _mm_set_ps(lin[b[24]], lin[b[16]], lin[b[8]], lin[b[0]]));
+		sum = _mm_add_ps(sum, _mm_set_ps(lin[b[28]], lin[b[20]], lin[b[12]], lin[b[4]]));
+
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(sum, _mm_set1_ps(INDEX_SCALE)), _mm_set1_ps(0.5f)));
+	}
+
+	// Alpha of four output texels, filtered as raw bytes, in the top 8 bits of each lane
+	inline __m128i averageAlpha4(const uint8_t* top, const uint8_t* bottom) {
+
+		// Eight source columns, each summed vertically
+		__m128i left = _mm_add_epi32(_mm_srli_epi32(_mm_loadu_si128((const __m128i*)top), 24), _mm_srli_epi32(_mm_loadu_si128((const __m128i*)bottom), 24));
+		__m128i right = _mm_add_epi32(_mm_srli_epi32(_mm_loadu_si128((const __m128i*)(top + 16)), 24), _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(bottom + 16)), 24));
+
+		// Then even columns plus odd columns
+		__m128 even = _mm_shuffle_ps(_mm_castsi128_ps(left), _mm_castsi128_ps(right), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(left), _mm_castsi128_ps(right), _MM_SHUFFLE(3, 1, 3, 1));
+		__m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd)), _mm_set1_epi32(2));
+		return _mm_slli_epi32(_mm_srli_epi32(sum, 2), 24);
+	}
+#endif
+}
+
+uint32_t MipGenerator::levelCount(uint32_t width, uint32_t height) {
+	uint32_t largest = width > height ? width : height;
+	uint32_t levels = 1;
+	while (largest > 1) {
+		largest >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+void MipGenerator::downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination, bool srgb) {
+
+	const SrgbTables& tables = srgbTables();
+
+	uint32_t outWidth = levelSize(width, 1);
+	uint32_t outHeight = levelSize(height, 1);
+
+	// A 1-texel-wide or -tall source reuses its only column or row
+	uint32_t columnStep = width > 1 ? 4 : 0;
+	size_t rowStep = height > 1 ? (size_t)width * 4 : 0;
+
+	for (uint32_t y = 0; y < outHeight; y++) {
+
+		const uint8_t* row0 = source + (size_t)y * 2 * width * 4;
+		const uint8_t* row1 = row0 + rowStep;
+		uint8_t* out = destination + (size_t)y * outWidth * 4;
+
+		uint32_t x = 0;
+
+#ifdef MIPGENERATOR_SSE2
+		// Raw bytes: two output texels per step from a pair of 16-byte loads,
+		// summed in 16-bit lanes so the result matches the scalar path exactly
+		if (!srgb && columnStep != 0) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i rounding = _mm_set1_epi16(2);
+
+			for (; x + 1 < outWidth; x += 2) {
+				__m128i top = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+				__m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+
+				// Texels 0-1 and 2-3, each column summed vertically
+				__m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				// Then neighbouring columns, leaving one summed texel in each low half
+				left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+				right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+
+				__m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(left, right), rounding), 2);
+				_mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, zero));
+			}
+		}
+
+		// sRGB: four output texels per step, one channel per register; only the
+		// encode goes back through the table a texel at a time
+		if (srgb && columnStep != 0) {
+			int32_t red[4], green[4], blue[4];
+			for (; x + 3 < outWidth; x += 4) {
+				const uint8_t* top = row0 + x * 8;
+				const uint8_t* bottom = row1 + x * 8;
+
+				_mm_storeu_si128((__m128i*)red, averageSrgb4(top, bottom, 0, tables.toLinear));
+				_mm_storeu_si128((__m128i*)green, averageSrgb4(top, bottom, 1, tables.toLinear));
+				_mm_storeu_si128((__m128i*)blue, averageSrgb4(top, bottom, 2, tables.toLinear));
+				_mm_storeu_si128((__m128i*)(out + x * 4), averageAlpha4(top, bottom));
+
+				for (int i = 0; i < 4; i++) {
+					uint8_t* texel = out + (x + i) * 4;
+					texel[0] = tables.toSrgb[red[i]];
+					texel[1] = tables.toSrgb[green[i]];
+					texel[2] = tables.toSrgb[blue[i]];
+				}
+			}
+		}
+#endif
+
+		for (; x < outWidth; x++) {
+			const uint8_t* a = row0 + x * 8;
+			const uint8_t* b = a + columnStep;
+			const uint8_t* c = row1 + x * 8;
+			const uint8_t* d = c + columnStep;
+
+			if (srgb)
+				averageSrgb(a, b, c, d, out + x * 4, tables);
+			else
+				averageLinear(a, b, c, d, out + x * 4);
+		}
+	}
+}
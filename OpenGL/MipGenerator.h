@@ -0,0 +1,28 @@
+#ifndef MIPGENERATOR_H
+#define MIPGENERATOR_H
+
+#include <cstdint>
+
+// Box-filtered mip chain generation for tightly packed RGBA8 images.
+//
+// Colour textures are stored sRGB-encoded, so averaging the raw bytes darkens
+// every level. With srgb set, RGB is decoded to linear light, filtered there
+// and re-encoded; alpha is always filtered linearly. Where the target has
+// SSE2, both modes filter several output texels per step.
+class MipGenerator {
+
+public:
+
+	// Levels in a full chain down to 1x1
+	static uint32_t levelCount(uint32_t width, uint32_t height);
+
+	static uint32_t levelSize(uint32_t size, uint32_t level) {
+		uint32_t result = size >> level;
+		return result > 0 ? result : 1;
+	}
+
+	// Writes the next level down (max(1, width / 2) x max(1, height / 2)) into destination
+	static void downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination, bool srgb);
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "ObjectBuffer.h"
+
+static ObjectRecord makeRecord(const glm::mat4& model) {
+
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+	ObjectRecord record;
+	record.model = model;
+	for (int i = 0; i < 3; i++)
+		record.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+
+	return record;
+}
+
+GLuint ObjectBuffer::add(const glm::mat4& model) {
+	return RecordBuffer<ObjectRecord>::add(makeRecord(model));
+}
+
+void ObjectBuffer::setTransform(GLuint index, const glm::mat4& model) {
+
+	// Static objects keep their record clean and cost nothing per frame
+	if (records[index].model == model)
+		return;
+
+	records[index] = makeRecord(model);
+	markDirty(index);
+}
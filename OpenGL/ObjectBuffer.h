@@ -0,0 +1,37 @@
+#ifndef OBJECTBUFFER_H
+#define OBJECTBUFFER_H
+
+#include "RecordBuffer.h"
+#include <glm/glm.hpp>
+
+// One ObjectData record as laid out (std430) in Basic_shader.vert.
+// The normal matrix is a mat3, which std430 stores as three vec4 columns.
+struct ObjectRecord {
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3];
+};
+
+static_assert(sizeof(ObjectRecord) == 112, "ObjectRecord must match the std430 ObjectData layout");
+
+// Per-object transforms for the ObjectBlock shader storage buffer. The normal
+// matrix is computed once on the CPU when a transform changes instead of for
+// every vertex; draws select their record through the objectIndex uniform.
+class ObjectBuffer : public RecordBuffer<ObjectRecord> {
+
+public:
+
+	// Matches layout(binding = 1) on ObjectBlock
+	static const GLuint BINDING = 1;
+
+	ObjectBuffer() : RecordBuffer<ObjectRecord>(GL_SHADER_STORAGE_BUFFER, BINDING) {}
+
+	GLuint add(const glm::mat4& model = glm::mat4(1.0));
+
+	void setTransform(GLuint index, const glm::mat4& model);
+
+	const glm::mat4& getTransform(GLuint index) const {
+		return get(index).model;
+	}
+};
+
+#endif
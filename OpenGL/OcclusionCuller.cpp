@@ -0,0 +1,303 @@
+#include "OcclusionCuller.h"
+#include "FrameStats.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSIONCULLER_SSE2
+#include <emmintrin.h>
+#endif
+
+static_assert(OcclusionCuller::WIDTH % 4 == 0, "Rows are processed four pixels at a time");
+static_assert(OcclusionCuller::HEIGHT % OcclusionCuller::BAND_HEIGHT == 0, "Bands must tile the buffer");
+
+OccluderMesh OccluderMesh::fromImage(const MeshCacheImage& image, GLuint maxTriangles) {
+
+	struct Candidate {
+		float area;
+		uint32_t mesh;
+		uint32_t firstIndex;
+	};
+
+	std::vector<Candidate> candidates;
+	const MeshCacheHeader& header = image.header();
+
+	for (uint32_t m = 0; m < header.meshCount; m++) {
+		const uint32_t* indices = image.indices(m);
+
+		for (uint32_t i = 0; i + 2 < image.mesh(m).indexCount; i += 3) {
+			glm::vec3 a = image.position(m, indices[i]);
+			glm::vec3 b = image.position(m, indices[i + 1]);
+			glm::vec3 c = image.position(m, indices[i + 2]);
+
+			Candidate candidate;
+			candidate.area = glm::length(glm::cross(b - a, c - a));
+			candidate.mesh = m;
+			candidate.firstIndex = i;
+			if (candidate.area > 0.0f)
+				candidates.push_back(candidate);
+		}
+	}
+
+	// Small triangles cost as much to set up as large ones but hide almost nothing
+	size_t keep = std::min<size_t>(maxTriangles, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(),
+		[](const Candidate& x, const Candidate& y) { return x.area > y.area; });
+
+	OccluderMesh occluder;
+	occluder.vertices.reserve(keep * 3);
+	for (size_t i = 0; i < keep; i++) {
+		const uint32_t* indices = image.indices(candidates[i].mesh) + candidates[i].firstIndex;
+		for (int corner = 0; corner < 3; corner++)
+			occluder.vertices.push_back(image.position(candidates[i].mesh, indices[corner]));
+	}
+	return occluder;
+}
+
+OcclusionCuller::OcclusionCuller() : viewProjection(1.0f), depth(WIDTH * HEIGHT, 0.0f) {
+}
+
+void OcclusionCuller::begin(const glm::mat4& viewProjectionIn) {
+	viewProjection = viewProjectionIn;
+	triangles.clear();
+}
+
+void OcclusionCuller::addOccluder(const OccluderMesh& mesh, const glm::mat4& transform) {
+
+	glm::mat4 toClip = viewProjection * transform;
+
+	for (size_t i = 0; i + 2 < mesh.vertices.size(); i += 3) {
+
+		glm::vec4 clip[3];
+		for (int corner = 0; corner < 3; corner++)
+			clip[corner] = toClip * glm::vec4(mesh.vertices[i + corner], 1.0f);
+
+		// Trivially outside one of the side planes
+		if ((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+			(clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+			(clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+			(clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w))
+			continue;
+
+		// Clip against the near plane (z + w >= 0), which leaves at most a quad
+		glm::vec4 polygon[4];
+		int count = 0;
+		for (int corner = 0; corner < 3; corner++) {
+			const glm::vec4& from = clip[corner];
+			const glm::vec4& to = clip[(corner + 1) % 3];
+			float fromDistance = from.z + from.w;
+			float toDistance = to.z + to.w;
+
+			if (fromDistance >= 0.0f)
+				polygon[count++] = from;
+			if ((fromDistance >= 0.0f) != (toDistance >= 0.0f))
+				polygon[count++] = from + (to - from) * (fromDistance / (fromDistance - toDistance));
+		}
+
+		for (int corner = 2; corner < count; corner++)
+			addTriangle(polygon[0], polygon[corner - 1], polygon[corner]);
+	}
+}
+
+void OcclusionCuller::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+
+	if (a.w <= 0.0f || b.w <= 0.0f || c.w <= 0.0f)
+		return;
+
+	ScreenTriangle triangle;
+	const glm::vec4* clip[3] = { &a, &b, &c };
+	for (int corner = 0; corner < 3; corner++) {
+		float invW = 1.0f / clip[corner]->w;
+		triangle.vertices[corner] = glm::vec3(
+			(clip[corner]->x * invW * 0.5f + 0.5f) * WIDTH,
+			(clip[corner]->y * invW * 0.5f + 0.5f) * HEIGHT,
+			invW);
+	}
+
+	const glm::vec3& v0 = triangle.vertices[0];
+	const glm::vec3& v1 = triangle.vertices[1];
+	const glm::vec3& v2 = triangle.vertices[2];
+
+	// Counter-clockwise is front facing, matching glFrontFace(GL_CCW)
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (!(area > 0.0f))
+		return;
+
+	triangle.minY = std::min(v0.y, std::min(v1.y, v2.y));
+	triangle.maxY = std::max(v0.y, std::max(v1.y, v2.y));
+	triangles.push_back(triangle);
+}
+
+void OcclusionCuller::rasterize() {
+
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	std::fill(depth.begin(), depth.end(), 0.0f);
+
+	// Bands own disjoint rows, so they need no synchronisation
+	WorkerPool::shared().parallelFor(HEIGHT / BAND_HEIGHT, [this](size_t band) { rasterizeBand((GLuint)band); });
+
+	frameStats.occlusionMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void OcclusionCuller::rasterizeBand(GLuint band) {
+
+	GLuint firstRow = band * BAND_HEIGHT;
+	GLuint endRow = firstRow + BAND_HEIGHT;
+
+	for (const ScreenTriangle& triangle : triangles) {
+		if (triangle.maxY < firstRow || triangle.minY > endRow)
+			continue;
+		rasterizeTriangle(triangle, firstRow, endRow);
+	}
+}
+
+// Pixel centres inside all three edges take the larger (closer) 1/w
+void OcclusionCuller::rasterizeTriangle(const ScreenTriangle& triangle, GLuint firstRow, GLuint endRow) {
+
+	const glm::vec3& v0 = triangle.vertices[0];
+	const glm::vec3& v1 = triangle.vertices[1];
+	const glm::vec3& v2 = triangle.vertices[2];
+
+	// Pixels whose centre can fall inside the triangle's bounds
+	float minX = std::min(v0.x, std::min(v1.x, v2.x));
+	float maxX = std::max(v0.x, std::max(v1.x, v2.x));
+	int firstColumn = std::max(0, (int)std::ceil(minX - 0.5f));
+	int lastColumn = std::min((int)WIDTH - 1, (int)std::floor(maxX - 0.5f));
+	int bottom = std::max((int)firstRow, (int)std::ceil(triangle.minY - 0.5f));
+	int top = std::min((int)endRow - 1, (int)std::floor(triangle.maxY - 0.5f));
+	if (firstColumn > lastColumn || bottom > top)
+		return;
+
+	// Edge functions A * x + B * y + C, positive inside a counter-clockwise triangle
+	const glm::vec3* from[3] = { &v1, &v2, &v0 };
+	const glm::vec3* to[3] = { &v2, &v0, &v1 };
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int i = 0; i < 3; i++) {
+		edgeA[i] = from[i]->y - to[i]->y;
+		edgeB[i] = to[i]->x - from[i]->x;
+		edgeC[i] = -(edgeA[i] * from[i]->x + edgeB[i] * from[i]->y);
+	}
+
+	// 1/w is linear in screen space
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	float depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+	float depthY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+	float depthC = v0.z - depthX * v0.x - depthY * v0.y;
+
+	// Start on a four-pixel boundary; lanes left of the triangle fail the edge test
+	int alignedColumn = firstColumn & ~3;
+
+	for (int row = bottom; row <= top; row++) {
+
+		float y = row + 0.5f;
+		float* out = &depth[row * WIDTH];
+
+#ifdef OCCLUSIONCULLER_SSE2
+		__m128 zero = _mm_setzero_ps();
+		__m128 rowEdge0 = _mm_set1_ps(edgeB[0] * y + edgeC[0]);
+		__m128 rowEdge1 = _mm_set1_ps(edgeB[1] * y + edgeC[1]);
+		__m128 rowEdge2 = _mm_set1_ps(edgeB[2] * y + edgeC[2]);
+		__m128 rowDepth = _mm_set1_ps(depthY * y + depthC);
+		__m128 x = _mm_add_ps(_mm_set1_ps((float)alignedColumn), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+		__m128 step = _mm_set1_ps(4.0f);
+
+		for (int column = alignedColumn; column <= lastColumn; column += 4) {
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(edgeA[0])), rowEdge0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(edgeA[1])), rowEdge1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(edgeA[2])), rowEdge2);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+
+			if (_mm_movemask_ps(inside) != 0) {
+				__m128 current = _mm_loadu_ps(out + column);
+				__m128 closer = _mm_max_ps(current, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(depthX)), rowDepth));
+				_mm_storeu_ps(out + column, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, current)));
+			}
+
+			x = _mm_add_ps(x, step);
+		}
+#else
+		for (int column = alignedColumn; column <= lastColumn; column++) {
+			float x = column + 0.5f;
+			if (edgeA[0] * x + edgeB[0] * y + edgeC[0] < 0.0f ||
+				edgeA[1] * x + edgeB[1] * y + edgeC[1] < 0.0f ||
+				edgeA[2] * x + edgeB[2] * y + edgeC[2] < 0.0f)
+				continue;
+			out[column] = std::max(out[column], depthX * x + depthY * y + depthC);
+		}
+#endif
+	}
+}
+
+bool OcclusionCuller::isOccluded(const glm::vec3& centre, const glm::vec3& extent) const {
+
+	float minX = (float)WIDTH, maxX = 0.0f;
+	float minY = (float)HEIGHT, maxY = 0.0f;
+	float nearest = 0.0f;	// Largest 1/w over the corners
+
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 offset((corner & 1) ? extent.x : -extent.x, (corner & 2) ? extent.y : -extent.y, (corner & 4) ? extent.z : -extent.z);
+		glm::vec4 clip = viewProjection * glm::vec4(centre + offset, 1.0f);
+
+		// Anything reaching the near plane could cover the whole screen
+		if (clip.z + clip.w < 0.0f || clip.w <= 0.0f)
+			return false;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+		float y = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::max(nearest, invW);
+	}
+
+	// Every pixel the rectangle touches
+	int firstColumn = std::max(0, (int)std::floor(minX));
+	int lastColumn = std::min((int)WIDTH - 1, (int)std::floor(maxX));
+	int bottom = std::max(0, (int)std::floor(minY));
+	int top = std::min((int)HEIGHT - 1, (int)std::floor(maxY));
+	if (firstColumn > lastColumn || bottom > top)
+		return false;
+
+	// Visible as soon as one pixel's occluder is no closer than the box
+	for (int row = bottom; row <= top; row++) {
+
+		const float* in = &depth[row * WIDTH];
+
+#ifdef OCCLUSIONCULLER_SSE2
+		__m128 limit = _mm_set1_ps(nearest);
+		for (int column = firstColumn & ~3; column <= lastColumn; column += 4) {
+			int lanes = 0xF;
+			if (column < firstColumn)
+				lanes &= 0xF << (firstColumn - column);
+			if (column + 3 > lastColumn)
+				lanes &= 0xF >> (column + 3 - lastColumn);
+
+			if (_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(in + column), limit)) & lanes)
+				return false;
+		}
+#else
+		for (int column = firstColumn; column <= lastColumn; column++) {
+			if (in[column] <= nearest)
+				return false;
+		}
+#endif
+	}
+
+	return true;
+}
+
+void OcclusionCuller::cull(FrustumCuller& culler, GLuint first, GLuint count) const {
+
+	for (GLuint slot = first; slot < first + count; slot++) {
+		if (culler.isVisible(slot) && isOccluded(culler.getCentre(slot), culler.getExtent(slot))) {
+			culler.hide(slot);
+			frameStats.occludedObjects++;
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include "FrustumCuller.h"
+#include "MeshCache.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Simplified stand-in for a model's surface, used only by the OcclusionCuller.
+// Built from the largest triangles of the real mesh, so it never covers more
+// than the model itself does.
+struct OccluderMesh {
+	std::vector<glm::vec3> vertices;	// Model space, three per triangle
+
+	static OccluderMesh fromImage(const MeshCacheImage& image, GLuint maxTriangles);
+
+	GLuint getTriangleCount() const {
+		return (GLuint)(vertices.size() / 3);
+	}
+};
+
+// CPU occlusion culling. Each frame, occluder meshes are clipped against the
+// near plane and rasterised into a low-resolution buffer of 1/w (larger is
+// closer), four pixels at a time with SSE, in horizontal bands spread over
+// WorkerPool::shared(). Boxes are then tested by their screen-space rectangle
+// and nearest point. Nothing here touches GL, so it runs without a context.
+class OcclusionCuller {
+
+public:
+
+	static const GLuint WIDTH = 256;
+	static const GLuint HEIGHT = 144;
+	static const GLuint BAND_HEIGHT = 16;	// Rows rasterised by one job
+
+private:
+
+	// Occluder triangle after clipping: screen position and 1/w per vertex
+	struct ScreenTriangle {
+		glm::vec3 vertices[3];
+		float minY;
+		float maxY;
+	};
+
+	glm::mat4 viewProjection;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<float> depth;	// WIDTH * HEIGHT, row 0 at the bottom of the screen
+
+	void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	void rasterizeBand(GLuint band);
+	void rasterizeTriangle(const ScreenTriangle& triangle, GLuint firstRow, GLuint endRow);
+
+public:
+
+	OcclusionCuller();
+
+	// Starts a frame with a new camera and no occluders
+	void begin(const glm::mat4& viewProjectionIn);
+
+	// Clips and projects the mesh under transform; back faces are dropped, as GL_CULL_FACE would
+	void addOccluder(const OccluderMesh& mesh, const glm::mat4& transform);
+
+	// Fills the depth buffer from every occluder added since begin()
+	void rasterize();
+
+	// True if the world-space box is hidden behind the rasterised occluders
+	bool isOccluded(const glm::vec3& centre, const glm::vec3& extent) const;
+
+	// Hides the culler slots in [first, first + count) that are still visible but occluded
+	void cull(FrustumCuller& culler, GLuint first, GLuint count) const;
+
+	const std::vector<float>& getDepth() const {
+		return depth;
+	}
+	GLuint getTriangleCount() const {
+		return (GLuint)triangles.size();
+	}
+};
+
+#endif
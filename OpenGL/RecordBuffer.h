@@ -0,0 +1,140 @@
+#ifndef RECORDBUFFER_H
+#define RECORDBUFFER_H
+
+#include "GLExtensions.h"
+#include <algorithm>
+#include <vector>
+
+// GPU buffer of fixed-size records mirrored by a CPU array. Writes flag only
+// the records whose value actually changed, and upload() sends each
+// contiguous run of dirty records with a single glBufferSubData. The buffer
+// grows by doubling, so record counts are only bounded by GPU memory.
+// An optional header region sits in front of the first record.
+template <typename Record>
+class RecordBuffer {
+
+protected:
+
+	GLenum target;
+	GLuint binding;
+	GLsizeiptr headerSize;
+
+	GLuint buffer;
+	GLuint capacity;	// Records the GPU buffer can hold
+
+	std::vector<Record> records;
+	std::vector<bool> dirty;
+	bool anyDirty;
+
+	void markDirty(GLuint index) {
+		dirty[index] = true;
+		anyDirty = true;
+	}
+
+	// Makes sure the GPU buffer can hold every record and binds it.
+	// Returns true when the storage was (re)allocated and its contents lost.
+	bool reserve() {
+
+		bool reallocated = false;
+
+		if (buffer == 0 || records.size() > capacity) {
+			if (buffer == 0)
+				glGenBuffers(1, &buffer);
+
+			capacity = std::max<GLuint>(16, std::max<GLuint>(capacity * 2, (GLuint)records.size()));
+
+			glBindBuffer(target, buffer);
+			glBufferData(target, headerSize + capacity * sizeof(Record), NULL, GL_DYNAMIC_DRAW);
+			glBindBufferBase(target, binding, buffer);
+
+			std::fill(dirty.begin(), dirty.end(), true);
+			anyDirty = true;
+			reallocated = true;
+		}
+
+		glBindBuffer(target, buffer);
+		return reallocated;
+	}
+
+	void uploadDirty() {
+
+		if (!anyDirty)
+			return;
+
+		GLuint count = (GLuint)records.size();
+		GLuint i = 0;
+		while (i < count) {
+			if (!dirty[i]) {
+				i++;
+				continue;
+			}
+
+			GLuint runStart = i;
+			while (i < count && dirty[i]) {
+				dirty[i] = false;
+				i++;
+			}
+
+			glBufferSubData(target,
+				headerSize + runStart * sizeof(Record),
+				(i - runStart) * sizeof(Record),
+				&records[runStart]);
+		}
+
+		anyDirty = false;
+	}
+
+public:
+
+	RecordBuffer(GLenum targetIn, GLuint bindingIn, GLsizeiptr headerSizeIn = 0)
+		: target(targetIn), binding(bindingIn), headerSize(headerSizeIn), buffer(0), capacity(0), anyDirty(false) {}
+
+	RecordBuffer(const RecordBuffer&) = delete;
+	RecordBuffer& operator=(const RecordBuffer&) = delete;
+
+	GLuint add(const Record& record) {
+		records.push_back(record);
+		dirty.push_back(false);
+
+		GLuint index = (GLuint)records.size() - 1;
+		markDirty(index);
+		return index;
+	}
+
+	template <typename T>
+	void set(GLuint index, T Record::* field, const T& value) {
+		Record& record = records[index];
+		if (record.*field == value)
+			return;
+
+		record.*field = value;
+		markDirty(index);
+	}
+
+	const Record& get(GLuint index) const {
+		return records[index];
+	}
+	GLuint size() const {
+		return (GLuint)records.size();
+	}
+	GLuint getBuffer() const {
+		return buffer;
+	}
+
+	// Uploads the dirty records; call once per frame with a GL context current
+	void upload() {
+		reserve();
+		uploadDirty();
+	}
+
+	// Frees the GL buffer; must run before the context is destroyed
+	void release() {
+		if (buffer != 0)
+			glDeleteBuffers(1, &buffer);
+
+		buffer = 0;
+		capacity = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "RenderQueue.h"
+#include "FrameStats.h"
+#include "GeometryArena.h"
+#include "GLStateCache.h"
+#include <algorithm>
+
+static const uint32_t PASS_SHIFT = 62;
+
+RenderQueue::RenderQueue() : farDistance(1.0f) {}
+
+uint64_t RenderQueue::indexOf(std::vector<GLuint>& ids, GLuint name, uint32_t bits) {
+
+	size_t index = std::find(ids.begin(), ids.end(), name) - ids.begin();
+	if (index == ids.size())
+		ids.push_back(name);
+
+	// Past the field's range names share indices; grouping suffers, correctness does not
+	return (uint64_t)index & ((1ull << bits) - 1);
+}
+
+void RenderQueue::begin(float farDistanceIn) {
+	farDistance = farDistanceIn > 0.0f ? farDistanceIn : 1.0f;
+	packets.clear();
+	entries.clear();
+}
+
+void RenderQueue::submit(Pass pass, float depth, const RenderPacket& packet) {
+
+	uint64_t program = indexOf(programIds, packet.program, PROGRAM_BITS);
+	uint64_t texture = indexOf(textureIds, packet.texture, TEXTURE_BITS);
+	uint64_t vertexArray = indexOf(vertexArrayIds, packet.vertexArray, VERTEX_ARRAY_BITS);
+
+	const uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+	uint64_t quantised = (uint64_t)(std::min(std::max(depth / farDistance, 0.0f), 1.0f) * depthMax);
+
+	uint64_t state = (program << (TEXTURE_BITS + VERTEX_ARRAY_BITS)) | (texture << VERTEX_ARRAY_BITS) | vertexArray;
+	const uint32_t stateBits = PROGRAM_BITS + TEXTURE_BITS + VERTEX_ARRAY_BITS;
+	const uint32_t unusedBits = PASS_SHIFT - stateBits - DEPTH_BITS;
+
+	SortEntry entry;
+	entry.packet = (uint32_t)packets.size();
+	if (pass == PASS_OPAQUE)
+		entry.key = ((uint64_t)pass << PASS_SHIFT) | (state << (DEPTH_BITS + unusedBits)) | (quantised << unusedBits);
+	else
+		entry.key = ((uint64_t)pass << PASS_SHIFT) | ((depthMax - quantised) << (stateBits + unusedBits)) | (state << unusedBits);
+
+	entries.push_back(entry);
+	packets.push_back(packet);
+}
+
+void RenderQueue::sortEntries() {
+
+	scratch.resize(entries.size());
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+
+		size_t counts[256] = {};
+		for (const SortEntry& entry : entries)
+			counts[(entry.key >> shift) & 0xff]++;
+
+		// Every key has the same digit here: the order would not change
+		if (counts[(entries[0].key >> shift) & 0xff] == entries.size())
+			continue;
+
+		size_t offsets[256];
+		size_t total = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			offsets[digit] = total;
+			total += counts[digit];
+		}
+
+		// Stable scatter, so ties keep submission order
+		for (const SortEntry& entry : entries)
+			scratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+		entries.swap(scratch);
+	}
+}
+
+RenderQueue::Switches RenderQueue::countSwitches(bool sorted) const {
+
+	Switches switches = { 0, 0, 0 };
+	const RenderPacket* previous = nullptr;
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		const RenderPacket& packet = packets[sorted ? entries[i].packet : i];
+		switches.programs += previous == nullptr || packet.program != previous->program;
+		switches.textures += previous == nullptr || packet.texture != previous->texture;
+		switches.vertexArrays += previous == nullptr || packet.vertexArray != previous->vertexArray;
+		previous = &packet;
+	}
+	return switches;
+}
+
+void RenderQueue::execute() {
+
+	if (packets.empty())
+		return;
+
+	Switches unsorted = countSwitches(false);
+	frameStats.unsortedProgramSwitches += unsorted.programs;
+	frameStats.unsortedTextureSwitches += unsorted.textures;
+	frameStats.unsortedVertexArraySwitches += unsorted.vertexArrays;
+
+	sortEntries();
+
+	Switches sorted = countSwitches(true);
+	frameStats.programSwitches += sorted.programs;
+	frameStats.textureSwitches += sorted.textures;
+	frameStats.vertexArraySwitches += sorted.vertexArrays;
+
+	GLStateCache& state = GLStateCache::shared();
+	const RenderPacket* previous = nullptr;
+	bool blending = false;
+
+	for (const SortEntry& entry : entries) {
+
+		const RenderPacket& packet = packets[entry.packet];
+
+		if (!blending && (entry.key >> PASS_SHIFT) == PASS_TRANSPARENT) {
+			state.setEnabled(GL_BLEND, true);
+			state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			state.depthMask(GL_FALSE);
+			blending = true;
+		}
+
+		state.useProgram(packet.program);
+		state.bindTexture(0, GL_TEXTURE_2D, packet.texture);
+		state.bindVertexArray(packet.vertexArray);
+
+		// Uniforms belong to the program, so a new program always needs its own
+		if (previous == nullptr || packet.program != previous->program || packet.objectIndex != previous->objectIndex || packet.objectIndexLocation != previous->objectIndexLocation)
+			glUniform1ui(packet.objectIndexLocation, packet.objectIndex);
+
+		if (previous == nullptr || packet.decodeScale != previous->decodeScale || packet.decodeOffset != previous->decodeOffset) {
+			glVertexAttrib4f(GeometryArena::DECODE_SCALE_LOCATION, packet.decodeScale.x, packet.decodeScale.y, packet.decodeScale.z, packet.decodeScale.w);
+			glVertexAttrib3f(GeometryArena::DECODE_OFFSET_LOCATION, packet.decodeOffset.x, packet.decodeOffset.y, packet.decodeOffset.z);
+		}
+		glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, (void*)((size_t)packet.firstIndex * sizeof(uint32_t)), packet.baseVertex);
+
+		frameStats.drawCalls++;
+		frameStats.triangles += packet.indexCount / 3;
+		previous = &packet;
+	}
+
+	if (blending) {
+		state.setEnabled(GL_BLEND, false);
+		state.depthMask(GL_TRUE);
+	}
+
+	packets.clear();
+	entries.clear();
+}
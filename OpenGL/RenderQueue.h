@@ -0,0 +1,98 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include "GLExtensions.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Everything needed to issue one draw, captured at submission
+struct RenderPacket {
+	GLuint program;
+	GLuint texture;	// GL_TEXTURE_2D on unit 0
+	GLuint vertexArray;
+	GLint objectIndexLocation;	// -1 if the program has no objectIndex
+	GLuint objectIndex;
+	glm::vec4 decodeScale;	// Constant attributes 3 and 4, as StaticModel sets them
+	glm::vec3 decodeOffset;
+	GLuint indexCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+};
+
+// Collects draws for a frame, sorts them by a 64-bit key and issues them
+// with as few program, texture and VAO changes as the key allows.
+//
+// Opaque keys put state first and depth last, so equal state is drawn
+// front to back for early-z. Transparent keys put inverted depth first, so
+// blending sees them back to front whatever their state. Program, texture
+// and VAO names go into the key as small indices assigned on first sight,
+// which keeps keys stable from frame to frame.
+class RenderQueue {
+
+public:
+
+	enum Pass {
+		PASS_OPAQUE = 0,
+		PASS_TRANSPARENT = 1	// Blended, without depth writes
+	};
+
+	// Key layout, most significant first:
+	//   opaque:      pass:2 | program:10 | texture:14 | vao:8 | depth:24 | unused:6
+	//   transparent: pass:2 | ~depth:24 | program:10 | texture:14 | vao:8 | unused:6
+	static const uint32_t PROGRAM_BITS = 10;
+	static const uint32_t TEXTURE_BITS = 14;
+	static const uint32_t VERTEX_ARRAY_BITS = 8;
+	static const uint32_t DEPTH_BITS = 24;
+
+	// State changes issuing a sequence of packets costs
+	struct Switches {
+		GLuint programs;
+		GLuint textures;
+		GLuint vertexArrays;
+	};
+
+private:
+
+	struct SortEntry {
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	std::vector<RenderPacket> packets;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	float farDistance;
+
+	// Name -> key index, in order of first sight
+	std::vector<GLuint> programIds;
+	std::vector<GLuint> textureIds;
+	std::vector<GLuint> vertexArrayIds;
+
+	static uint64_t indexOf(std::vector<GLuint>& ids, GLuint name, uint32_t bits);
+
+	// LSD radix sort on 8-bit digits; digits every key shares are skipped
+	void sortEntries();
+
+	Switches countSwitches(bool sorted) const;
+
+public:
+
+	RenderQueue();
+
+	// Starts a frame; depths are quantised over [0, farDistance]
+	void begin(float farDistance);
+
+	// depth is the distance from the eye along the view direction
+	void submit(Pass pass, float depth, const RenderPacket& packet);
+
+	// Sorts and issues every packet, then empties the queue. Counts draws,
+	// triangles and state switches (with what submission order would have cost) into frameStats.
+	void execute();
+
+	GLuint size() const {
+		return (GLuint)packets.size();
+	}
+};
+
+#endif
@@ -1,34 +1,40 @@
 #version 460 core
 
+#include "Lighting.glsl"
+
 in vec2 TexCoord;
 in vec3 Normal; 
 in vec3 Vertex;
-
-struct LightSource {
-	int enabled;
-
-	int type;
-    vec3 position;
-	float intensity;
-	vec3 direction;
-	vec3 colour;
-
-	vec4 ambient;
-	vec3 diffuse;
-	vec3 specular;
-
-	vec3 attenuation;
-	float cutOff;
-	float outerCutOff;
-};
+in vec4 ClipPos;
+in vec4 InstanceColour;
+
+// Cluster grid size, injected by LightClusters::shaderDefines()
+#if !defined(CLUSTER_X) || !defined(CLUSTER_Y) || !defined(CLUSTER_Z)
+#error CLUSTER_X, CLUSTER_Y and CLUSTER_Z must be defined
+#endif
+
+// Variant features, injected by ShaderVariantKey::defines():
+//   DIRECTIONAL_LIGHTS  number of directional lights
+//   BULB_LIGHTS         1 if any cluster can hold bulbs
+//   SPOT_LIGHTS         1 if any cluster can hold spots
+//   SPECULAR_MAP        1 to tint specular by texture_specular1
+//   SKYBOX_REFLECTION   1 to blend in the skybox by smoothness
+#if !defined(DIRECTIONAL_LIGHTS) || !defined(BULB_LIGHTS) || !defined(SPOT_LIGHTS) || !defined(SPECULAR_MAP) || !defined(SKYBOX_REFLECTION)
+#error Basic_shader.frag must be built through ShaderVariants
+#endif
 
 //Texture sampler
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 uniform samplerCube skybox;
 
-//Camera location
-uniform vec3 eyePos;
+//Camera information, matches CameraRecord in CameraBuffer.h (std140)
+layout(std140, binding = 0) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 eyePos;
+};
 
 //Light information
 //uniform vec4		lightPosition;
@@ -40,130 +46,83 @@ uniform vec4        matSpecularColour;
 uniform float       matSpecularExponent;
 uniform float       smoothness;
 
-uniform int lightCount;
-uniform LightSource Light[16];
+// Matches ClusterHeader in LightClusters.h (std430). clusters[i] is the offset
+// into lightIndices and the bulb (low 16 bits) and spot (high 16 bits) counts;
+// bulbs come first.
+layout(std430, binding = 2) readonly buffer ClusterBlock {
+	float depthScale;
+	float depthBias;
+	uint globalLightCount;	// Directional lights, at lightIndices[0, globalLightCount)
+	uint clusterPadding;
+	uvec2 clusters[];
+};
+
+layout(std430, binding = 3) readonly buffer ClusterLightBlock {
+	uint lightIndices[];
+};
 
 out vec4 FragColour;
 
-vec4 calculateLight(LightSource light) {
-	
-	if(light.enabled == 0) {
-		return vec4(0,0,0,1.0);
-	}
+uint clusterIndex() {
+	vec2 screen = clamp(ClipPos.xy / ClipPos.w * 0.5 + 0.5, 0.0, 1.0);
+	uvec2 tile = min(uvec2(screen * vec2(CLUSTER_X, CLUSTER_Y)), uvec2(CLUSTER_X - 1u, CLUSTER_Y - 1u));
 
-	// Ambience	
-	vec4 texColour = texture(texture_diffuse1, TexCoord);
-
-	// Diffuse
-	vec3 normalizedNormal = normalize(Normal);	
-	vec3 viewDirection = normalize(eyePos - Vertex);
-
-	vec4 ambient;
-	vec4 diffuse;
-	vec4 specular;
-
-	light.specular = vec3(1.0,1.0,1.0);
-
-	//Attenuation/drop-off	
-	float attD = length(light.position - Vertex);
-	float att = 1.0 / (light.attenuation.x + light.attenuation.y * attD + light.attenuation.z * (attD * attD));
-
-	if(light.type == 0) {
-		// Render PointLight
-
-		//Ambient light value
-		vec3 pointAmbient = (light.colour * light.intensity) * texColour.rgb;
-
-		//ambient = light.ambient * matAmbient * texColour * att * vec4(light.colour * light.intensity, 1.0);
-
-		//Diffuse light value
-
-		vec3 L = normalize(light.position - Vertex);
-		float lambertTerm = clamp(dot(normalizedNormal, L), 0.0, 1.0);
-		vec3 pointDiffuse = (light.colour * light.intensity) * texColour.rgb * lambertTerm;
-		//diffuse = matDiffuse * texColour * lambertTerm * att * vec4(light.colour * light.intensity, 1.0);
-
-		//Specular light value
-
-		vec3 R = reflect(-L, normalizedNormal); // reflected light vector about normal N
-		float specularIntensity = pow(max(dot(viewDirection, R), 0.0), matSpecularExponent);
-		vec3 pointSpecular = (light.colour * light.intensity) * texColour.rgb * specularIntensity;
-
-		pointAmbient *= att;
-		pointDiffuse *= att;
-		pointSpecular *= att;
-
-		ambient = vec4(pointAmbient, 1.0);
-		diffuse = vec4(pointDiffuse, 1.0);
-		specular = vec4(pointSpecular, 1.0);
-
-		
-	} else if(light.type == 1) {
-		// Render DirectionalLight
-
-		vec3 directionalAmbient = (light.colour * light.intensity) * texColour.rgb;
-		//ambient = light.ambient * matAmbient * texColour * vec4(light.colour * light.intensity, 1.0);
-
-		vec3 lightDir = normalize(-light.direction);
-		float diff = max(dot(normalizedNormal, lightDir), 0.0);
-		vec3 directionalDiffuse = (light.colour * light.intensity) * texColour.rgb * diff;
-		//diffuse = diff * texColour * vec4(light.colour * light.intensity, 1.0);
-
-		vec3 reflectDir = reflect(-lightDir, normalizedNormal);
-		float spec = pow(max(dot(viewDirection, reflectDir), 0.0), 1);
-		vec3 directionalSpecular = (light.colour * light.intensity) * texColour.rgb * spec;
-		//specular = matSpecularColour * texColour  * spec * vec4(light.colour * light.intensity, 1.0);
-
-		ambient = vec4(directionalAmbient, 1.0);
-		diffuse = vec4(directionalDiffuse, 1.0);
-		specular = vec4(directionalSpecular, 1.0);
-
-	} else if(light.type == 2) {
-		// Render Spotlight
-
-		// Calculate ambient lighting
-		vec3 spotAmbient = (light.colour * light.intensity) * texColour.rgb;
-    
-		// Calculate diffuse lighting
-		vec3 lightDir = normalize(light.position.xyz - Vertex);
-		float diff = max(dot(normalizedNormal, lightDir), 0.0);
-		vec3 spotDiffuse = (light.colour * light.intensity) * texColour.rgb * diff;
-    
-		// Calculate specular lighting
-		vec3 reflectDir = reflect(-lightDir, normalizedNormal);  
-		float spec = pow(max(dot(viewDirection, reflectDir), 0.0), light.intensity);
-		vec3 spotSpecular = (light.colour * light.intensity) * spec * matSpecularColour.rgb;
-    
-		// Calulate spotlight diffusion
-		float theta = dot(lightDir, normalize(-light.direction)); 
-		float epsilon = (light.cutOff - light.outerCutOff);
-		float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-		spotDiffuse  *= intensity;
-		spotSpecular *= intensity;
-    
-		// Multiply by the attenuation of the light
-		spotAmbient  *= att; 
-		spotDiffuse  *= att;
-		spotSpecular *= att;   
-
-		ambient = vec4(spotAmbient, 1.0);
-		diffuse = vec4(spotDiffuse, 1.0);
-		specular = vec4(spotSpecular, 1.0);
-	}
+	// ClipPos.w is the view-space depth; slices are spaced exponentially
+	uint slice = uint(clamp(log(ClipPos.w) * depthScale + depthBias, 0.0, float(CLUSTER_Z - 1u)));
 
-	return ambient + diffuse + specular;
+	return tile.x + CLUSTER_X * (tile.y + CLUSTER_Y * slice);
 }
 
 void main()
 {
-	vec4 finalColour;
-	for(int i = 0; i < lightCount; i++) {
-		finalColour += calculateLight(Light[i]);
+	Surface surface;
+	surface.position = Vertex;
+	surface.normal = normalize(Normal);
+	surface.viewDirection = normalize(eyePos.xyz - Vertex);
+	surface.albedo = texture(texture_diffuse1, TexCoord) * InstanceColour;
+#if SPECULAR_MAP
+	surface.specularColour = matSpecularColour.rgb * texture(texture_specular1, TexCoord).rgb;
+#else
+	surface.specularColour = matSpecularColour.rgb;
+#endif
+	surface.specularExponent = matSpecularExponent;
+
+	vec4 finalColour = vec4(0.0);
+
+#if DIRECTIONAL_LIGHTS > 0
+	// Fixed trip count; the guard covers a variant built for an older light set
+	for(uint i = 0u; i < uint(DIRECTIONAL_LIGHTS); i++) {
+		if(i < globalLightCount)
+			finalColour += directionalLight(Light[lightIndices[i]], surface);
+	}
+#endif
+
+	// Only the lights whose range reaches this fragment's cluster, already sorted by type
+	uvec2 cluster = clusters[clusterIndex()];
+	uint index = cluster.x;
+
+#if BULB_LIGHTS
+	uint bulbEnd = index + (cluster.y & 0xFFFFu);
+	for(; index < bulbEnd; index++) {
+		finalColour += bulbLight(Light[lightIndices[index]], surface);
+	}
+#else
+	index += cluster.y & 0xFFFFu;
+#endif
+
+#if SPOT_LIGHTS
+	uint spotEnd = index + (cluster.y >> 16);
+	for(; index < spotEnd; index++) {
+		finalColour += spotLight(Light[lightIndices[index]], surface);
 	}
+#endif
 
+#if SKYBOX_REFLECTION
 	// Stuff for skybox
-	vec3 I = normalize(Vertex - eyePos);
-    vec3 skyboxR = reflect(I, normalize(Normal));
+	vec3 I = normalize(Vertex - eyePos.xyz);
+	vec3 skyboxR = reflect(I, surface.normal);
+	finalColour.rgb = mix(finalColour.rgb, texture(skybox, skyboxR).rgb, smoothness);
+#endif
 
     FragColour = finalColour;
 }
\ No newline at end of file
@@ -1,25 +1,99 @@
-#version 330 core
+#version 460 core
 
-layout (location = 0) in vec3 vertexPos;
-layout (location = 1) in vec3 normal;
+#include "Indirect.glsl"
+
+layout (location = 0) in vec3 vertexPos;	// unorm16 within the mesh AABB when packed
+layout (location = 1) in vec3 normal;	// Octahedral in xy when packed
 layout (location = 2) in vec2 texCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Per-mesh decode constants; StaticModel sets them as current values with no array bound.
+// Indirect draws read them from the mesh record instead.
+layout (location = 3) in vec4 decodeScale;	// xyz scale the position; w is 1 for octahedral normals
+layout (location = 4) in vec3 decodeOffset;
+
+// Matches CameraRecord in CameraBuffer.h (std140)
+layout(std140, binding = 0) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 eyePos;
+};
+
+// Matches ObjectRecord in ObjectBuffer.h (std430)
+struct ObjectData {
+	mat4 model;
+	mat3 normalMatrix;	// Precomputed on the CPU
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBlock {
+	ObjectData objects[];
+};
+
+// Matches InstanceRecord in InstanceBuffer.h (std430)
+struct InstanceData {
+	mat4 model;
+	mat3 normalMatrix;
+	vec4 colour;
+};
+
+layout(std430, binding = 9) readonly buffer InstanceBlock {
+	InstanceData instances[];
+};
+
+// objectIndex for StaticModel::drawInstanced(); the record is instances[gl_InstanceID]
+const uint INSTANCED_DRAW = 0xfffffffeu;
+
+uniform uint objectIndex;	// INDIRECT_DRAW for IndirectRenderer's draws
 
 out vec2 TexCoord;
 out vec3 Normal; 
 out vec3 Vertex; 
+out vec4 ClipPos;	// Locates the fragment's light cluster
+out vec4 InstanceColour;	// White unless the draw is instanced
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
 
 void main()
 {
+	uint object = objectIndex;
+	vec4 scale = decodeScale;
+	vec3 offset = decodeOffset;
+	if (objectIndex == INDIRECT_DRAW) {
+		DrawItem item = drawItems[gl_BaseInstance];
+		object = item.objectIndex;
+		scale = indirectMeshes[item.meshIndex].decodeScale;
+		offset = indirectMeshes[item.meshIndex].decodeOffset.xyz;
+	}
+
+	mat4 model;
+	mat3 normalMatrix;
+	if (objectIndex == INSTANCED_DRAW) {
+		model = instances[gl_InstanceID].model;
+		normalMatrix = instances[gl_InstanceID].normalMatrix;
+		InstanceColour = instances[gl_InstanceID].colour;
+	}
+	else {
+		model = objects[object].model;
+		normalMatrix = objects[object].normalMatrix;
+		InstanceColour = vec4(1.0);
+	}
+
+	vec3 position = vertexPos * scale.xyz + offset;
+	vec3 objectNormal = scale.w > 0.5 ? decodeOctahedral(normal.xy) : normal;
 
 	TexCoord = texCoord;
 	
-	Normal = mat3(transpose(inverse(model))) * normal;  // normal vector in eye coordinates
+	Normal = normalMatrix * objectNormal;  // normal vector in world coordinates
 	
-	Vertex = vec3(model * vec4(vertexPos, 1.0)); // vertex in eye coordinates (map to vec3 since gl_Vertex is a vec4)
+	vec4 worldPos = model * vec4(position, 1.0);
+	Vertex = worldPos.xyz; // vertex in world coordinates
 
-	gl_Position = projection * view * model * vec4(vertexPos, 1.0f);
-}
\ No newline at end of file
+	gl_Position = viewProjection * worldPos;
+	ClipPos = gl_Position;
+}
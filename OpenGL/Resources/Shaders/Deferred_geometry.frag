@@ -0,0 +1,27 @@
+#version 460 core
+
+// Geometry pass of the deferred path: stores what Lighting.glsl needs to know
+// about the surface, once per pixel. Targets match the G-buffer in DeferredRenderer.h.
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 Vertex;
+in vec4 InstanceColour;
+
+//Texture sampler
+uniform sampler2D texture_diffuse1;
+
+//Material iformation
+uniform vec4        matSpecularColour;
+uniform float       matSpecularExponent;
+
+layout(location = 0) out vec4 Albedo;
+layout(location = 1) out vec4 NormalExponent;
+layout(location = 2) out vec4 Specular;
+
+void main()
+{
+	Albedo = texture(texture_diffuse1, TexCoord) * InstanceColour;
+	NormalExponent = vec4(normalize(Normal), matSpecularExponent);
+	Specular = matSpecularColour;
+}
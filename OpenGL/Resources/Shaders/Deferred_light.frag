@@ -0,0 +1,50 @@
+#version 460 core
+
+// Adds one light's contribution to every pixel its volume covers, reading the
+// surface back from the G-buffer
+
+#include "Lighting.glsl"
+
+// Matches CameraRecord in CameraBuffer.h (std140)
+layout(std140, binding = 0) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 eyePos;
+};
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+
+flat in uint lightIndex;
+
+out vec4 FragColour;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	if (depth == 1.0)
+		discard;
+
+	// World position back from the depth buffer
+	vec2 screen = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+	vec4 world = inverseViewProjection * vec4(vec3(screen, depth) * 2.0 - 1.0, 1.0);
+
+	vec4 normalExponent = texelFetch(gNormal, pixel, 0);
+
+	Surface surface;
+	surface.position = world.xyz / world.w;
+	surface.normal = normalExponent.xyz;
+	surface.viewDirection = normalize(eyePos.xyz - surface.position);
+	surface.albedo = texelFetch(gAlbedo, pixel, 0);
+	surface.specularColour = texelFetch(gSpecular, pixel, 0).rgb;
+	surface.specularExponent = normalExponent.w;
+
+	FragColour = calculateLight(Light[lightIndex], surface);
+}
@@ -0,0 +1,60 @@
+#version 460 core
+
+#include "Lighting.glsl"
+
+layout (location = 0) in vec3 vertexPos;
+
+// Matches CameraRecord in CameraBuffer.h (std140)
+layout(std140, binding = 0) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 eyePos;
+};
+
+// Matches LightVolumeRecord in DeferredRenderer.h (std430)
+struct LightVolume {
+	uint light;
+	float range;
+	float radius;
+	float padding;
+};
+
+layout(std430, binding = 4) readonly buffer LightVolumeBlock {
+	LightVolume volumes[];
+};
+
+uniform uint volumeBase;	// Record of the first instance in this draw
+uniform uint volumeShape;	// 0 unit sphere, 1 unit cone along +z, 2 fullscreen triangle
+
+flat out uint lightIndex;
+
+void main()
+{
+	LightVolume volume = volumes[volumeBase + gl_InstanceID];
+	lightIndex = volume.light;
+
+	if (volumeShape == 2u) {
+		vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+		gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+		return;
+	}
+
+	LightSource light = Light[volume.light];
+	vec3 worldPos;
+
+	if (volumeShape == 0u) {
+		worldPos = light.position + vertexPos * volume.range;
+	}
+	else {
+		// Apex on the light, base a full range down the spot direction
+		vec3 forward = normalize(light.direction);
+		vec3 helper = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+		vec3 right = normalize(cross(helper, forward));
+		vec3 up = cross(forward, right);
+
+		worldPos = light.position + (right * vertexPos.x + up * vertexPos.y) * volume.radius + forward * (vertexPos.z * volume.range);
+	}
+
+	gl_Position = viewProjection * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 460 core
+
+// Runs before the light volumes: blacks out every pixel the G-buffer covers so
+// the lights can be added on top of the skybox, and copies the scene depth
+// across for the volumes to test against.
+
+uniform sampler2D gDepth;
+
+out vec4 FragColour;
+
+void main()
+{
+	float depth = texelFetch(gDepth, ivec2(gl_FragCoord.xy), 0).r;
+	if (depth == 1.0)
+		discard;
+
+	gl_FragDepth = depth;
+	FragColour = vec4(0.0, 0.0, 0.0, 1.0);
+}
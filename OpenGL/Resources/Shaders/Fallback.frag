@@ -0,0 +1,16 @@
+#version 460 core
+
+// Stand-in for the lit material shaders while they are still compiling:
+// flat grey with a fixed key light, so shapes read without any light data.
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 Vertex;
+
+out vec4 FragColour;
+
+void main()
+{
+	float key = max(dot(normalize(Normal), normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+	FragColour = vec4(vec3(0.6 * (0.35 + 0.65 * key)), 1.0);
+}
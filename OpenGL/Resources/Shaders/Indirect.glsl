@@ -0,0 +1,49 @@
+// Records written by IndirectRenderer and shared by the culling pass
+// (Indirect_cull.comp) and Basic_shader.vert. Include after the version line.
+
+// objectIndex is set to this for draws issued by IndirectRenderer; the draw
+// then finds its DrawItem through gl_BaseInstance instead
+const uint INDIRECT_DRAW = 0xffffffffu;
+
+// Matches IndirectLod in IndirectRenderer.h
+struct IndirectLod {
+	uint firstIndex;	// Into the geometry arena's index buffer
+	uint indexCount;
+	float error;	// Worst over every mesh of the model, so the model switches as one
+	uint padding;
+};
+
+// Matches IndirectMeshRecord in IndirectRenderer.h (std430)
+struct IndirectMesh {
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec4 lodSphere;	// Whole model's bounding sphere: xyz centre, w radius
+	vec4 decodeScale;
+	vec4 decodeOffset;
+	uint baseVertex;
+	uint lodCount;
+	uint bucket;
+	uint padding;
+	IndirectLod lods[5];	// MESH_MAX_LODS
+};
+
+// Matches IndirectItemRecord in IndirectRenderer.h (std430): one per mesh drawn
+struct DrawItem {
+	uint objectIndex;	// Into ObjectBlock
+	uint meshIndex;	// Into MeshBlock
+	uint commandOffset;	// First command of the item's bucket
+	uint lod;	// Last level drawn, for hysteresis
+};
+
+// Only the culling pass writes items back
+#ifdef INDIRECT_CULL
+layout(std430, binding = 5) buffer DrawItemBlock {
+#else
+layout(std430, binding = 5) readonly buffer DrawItemBlock {
+#endif
+	DrawItem drawItems[];
+};
+
+layout(std430, binding = 6) readonly buffer IndirectMeshBlock {
+	IndirectMesh indirectMeshes[];
+};
@@ -0,0 +1,122 @@
+// Lighting shared by the forward shader (Basic_shader.frag) and the deferred
+// light pass (Deferred_light.frag). Include after the version line.
+
+// Field order matches LightRecord in LightBuffer.h (std430)
+struct LightSource {
+	vec3 position;
+	float intensity;
+	vec3 direction;
+	int type;
+	vec3 colour;
+	int enabled;
+
+	vec4 ambient;
+	vec3 diffuse;
+	float cutOff;
+
+	vec3 attenuation;
+	float outerCutOff;
+};
+
+layout(std430, binding = 0) readonly buffer LightBlock {
+	uint lightCount;
+	LightSource Light[];
+};
+
+// Everything calculateLight needs to know about the point being shaded
+struct Surface {
+	vec3 position;			// World space
+	vec3 normal;			// World space, normalised
+	vec3 viewDirection;		// Towards the eye, normalised
+	vec4 albedo;
+	vec3 specularColour;
+	float specularExponent;
+};
+
+// Attenuation/drop-off
+float attenuation(LightSource light, vec3 position) {
+	float attD = length(light.position - position);
+	return 1.0 / (light.attenuation.x + light.attenuation.y * attD + light.attenuation.z * (attD * attD));
+}
+
+// The per-type functions assume the light is enabled; disabled lights are
+// left out of the light lists on the CPU
+
+vec4 bulbLight(LightSource light, Surface surface) {
+
+	vec3 texColour = surface.albedo.rgb;
+	float att = attenuation(light, surface.position);
+
+	//Ambient light value
+	vec3 pointAmbient = (light.colour * light.intensity) * texColour;
+
+	//Diffuse light value
+	vec3 L = normalize(light.position - surface.position);
+	float lambertTerm = clamp(dot(surface.normal, L), 0.0, 1.0);
+	vec3 pointDiffuse = (light.colour * light.intensity) * texColour * lambertTerm;
+
+	//Specular light value
+	vec3 R = reflect(-L, surface.normal); // reflected light vector about normal N
+	float specularIntensity = pow(max(dot(surface.viewDirection, R), 0.0), surface.specularExponent);
+	vec3 pointSpecular = (light.colour * light.intensity) * texColour * specularIntensity;
+
+	return vec4((pointAmbient + pointDiffuse + pointSpecular) * att, 3.0);
+}
+
+vec4 directionalLight(LightSource light, Surface surface) {
+
+	vec3 texColour = surface.albedo.rgb;
+
+	vec3 directionalAmbient = (light.colour * light.intensity) * texColour;
+
+	vec3 lightDir = normalize(-light.direction);
+	float diff = max(dot(surface.normal, lightDir), 0.0);
+	vec3 directionalDiffuse = (light.colour * light.intensity) * texColour * diff;
+
+	vec3 reflectDir = reflect(-lightDir, surface.normal);
+	float spec = max(dot(surface.viewDirection, reflectDir), 0.0);
+	vec3 directionalSpecular = (light.colour * light.intensity) * texColour * spec;
+
+	return vec4(directionalAmbient + directionalDiffuse + directionalSpecular, 3.0);
+}
+
+vec4 spotLight(LightSource light, Surface surface) {
+
+	vec3 texColour = surface.albedo.rgb;
+	float att = attenuation(light, surface.position);
+
+	// Calculate ambient lighting
+	vec3 spotAmbient = (light.colour * light.intensity) * texColour;
+
+	// Calculate diffuse lighting
+	vec3 lightDir = normalize(light.position - surface.position);
+	float diff = max(dot(surface.normal, lightDir), 0.0);
+	vec3 spotDiffuse = (light.colour * light.intensity) * texColour * diff;
+
+	// Calculate specular lighting
+	vec3 reflectDir = reflect(-lightDir, surface.normal);
+	float spec = pow(max(dot(surface.viewDirection, reflectDir), 0.0), light.intensity);
+	vec3 spotSpecular = (light.colour * light.intensity) * spec * surface.specularColour;
+
+	// Calulate spotlight diffusion; nothing outside the cone, so a cone bounds the light
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = (light.cutOff - light.outerCutOff);
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+	return vec4((spotAmbient + spotDiffuse + spotSpecular) * intensity * att, 3.0);
+}
+
+// Any light type, for passes that do not know it up front
+vec4 calculateLight(LightSource light, Surface surface) {
+
+	if(light.enabled == 0) {
+		return vec4(0,0,0,1.0);
+	}
+
+	if(light.type == 0) {
+		return bulbLight(light, surface);
+	} else if(light.type == 1) {
+		return directionalLight(light, surface);
+	}
+	return spotLight(light, surface);
+}
@@ -3,11 +3,18 @@ layout(location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// Matches CameraRecord in CameraBuffer.h (std140); bound to point 0 from the application
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 eyePos;
+};
 
 void main()
 {
     TexCoords = aPos;
-    gl_Position = projection * view * vec4(aPos, 1.0);
-}
\ No newline at end of file
+
+    // Drop the translation so the skybox stays centred on the camera
+    gl_Position = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
+}
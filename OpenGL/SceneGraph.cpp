@@ -0,0 +1,73 @@
+#include "SceneGraph.h"
+
+GLuint SceneGraph::add(GLuint parent, const glm::mat4& local) {
+
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	changed.push_back(0);
+	objects.push_back((GLuint)NONE);
+	return (GLuint)parents.size() - 1;
+}
+
+void SceneGraph::setLocal(GLuint node, const glm::mat4& local) {
+
+	if (locals[node] == local)
+		return;
+
+	locals[node] = local;
+	dirty[node] = 1;
+}
+
+void SceneGraph::attachObject(GLuint node, GLuint objectIndex) {
+	objects[node] = objectIndex;
+	dirty[node] = 1;
+}
+
+GLuint SceneGraph::attachCamera(GLuint node, const glm::mat4& offset) {
+
+	CameraAttachment attachment = { node, offset };
+	cameras.push_back(attachment);
+	return (GLuint)cameras.size() - 1;
+}
+
+glm::mat4 SceneGraph::getCameraView(GLuint camera) const {
+	const CameraAttachment& attachment = cameras[camera];
+	return glm::inverse(worlds[attachment.node] * attachment.offset);
+}
+
+glm::vec3 SceneGraph::getCameraPosition(GLuint camera) const {
+	const CameraAttachment& attachment = cameras[camera];
+	return glm::vec3(worlds[attachment.node] * attachment.offset[3]);
+}
+
+glm::vec3 SceneGraph::getCameraDirection(GLuint camera) const {
+
+	// Cameras look down their local -z
+	const CameraAttachment& attachment = cameras[camera];
+	return glm::normalize(glm::vec3(worlds[attachment.node] * attachment.offset * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f)));
+}
+
+void SceneGraph::update(ObjectBuffer& objectBuffer) {
+
+	updatedCount = 0;
+
+	for (GLuint node = 0; node < parents.size(); node++) {
+
+		GLuint parent = parents[node];
+		bool parentChanged = parent != NONE && changed[parent];
+
+		changed[node] = dirty[node] || parentChanged;
+		if (!changed[node])
+			continue;
+
+		worlds[node] = parent != NONE ? worlds[parent] * locals[node] : locals[node];
+		dirty[node] = 0;
+		updatedCount++;
+
+		if (objects[node] != NONE)
+			objectBuffer.setTransform(objects[node], worlds[node]);
+	}
+
+}
@@ -0,0 +1,87 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include "ObjectBuffer.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Transform hierarchy kept as parallel arrays indexed by node. A node can only
+// be added under an existing node, so parents always come before their
+// children and update() is a single forward pass: a node's world matrix is
+// recomputed when its own local transform changed or its parent's world did,
+// and every other node is skipped.
+//
+// ObjectBuffer records and cameras can be attached to nodes; update() pushes
+// the new world transforms out to the records whose node changed. Lights
+// follow nodes through their LightComponent (see updateLights).
+class SceneGraph {
+
+public:
+
+	static const GLuint NONE = 0xffffffff;
+
+private:
+
+	struct CameraAttachment {
+		GLuint node;
+		glm::mat4 offset;	// Camera to node space
+	};
+
+	// One entry per node, parents first
+	std::vector<GLuint> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<uint8_t> dirty;	// Local transform changed since the last update()
+	std::vector<uint8_t> changed;	// World transform recomputed by the last update()
+	std::vector<GLuint> objects;	// Attached ObjectBuffer record, or NONE
+
+	std::vector<CameraAttachment> cameras;
+	GLuint updatedCount;
+
+public:
+
+	SceneGraph() : updatedCount(0) {}
+
+	// Adds a node under parent (NONE for a root) and returns its index
+	GLuint add(GLuint parent = NONE, const glm::mat4& local = glm::mat4(1.0));
+
+	// Marks the node dirty if local differs from its current transform
+	void setLocal(GLuint node, const glm::mat4& local);
+
+	const glm::mat4& getLocal(GLuint node) const {
+		return locals[node];
+	}
+	// As of the last update()
+	const glm::mat4& getWorld(GLuint node) const {
+		return worlds[node];
+	}
+	GLuint getParent(GLuint node) const {
+		return parents[node];
+	}
+
+	// The node's world transform becomes the record's model matrix
+	void attachObject(GLuint node, GLuint objectIndex);
+
+	// Mounts a camera on the node; offset places it in the node's space.
+	// Returns the handle for the getCamera* functions.
+	GLuint attachCamera(GLuint node, const glm::mat4& offset);
+
+	glm::mat4 getCameraView(GLuint camera) const;
+	glm::vec3 getCameraPosition(GLuint camera) const;
+	glm::vec3 getCameraDirection(GLuint camera) const;
+
+	// Recomputes the world transforms of dirty subtrees and updates what is
+	// attached to them. Call before the ObjectBuffer upload.
+	void update(ObjectBuffer& objectBuffer);
+
+	// World transforms recomputed by the last update()
+	GLuint getUpdatedCount() const {
+		return updatedCount;
+	}
+	GLuint size() const {
+		return (GLuint)parents.size();
+	}
+};
+
+#endif
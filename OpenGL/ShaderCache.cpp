@@ -0,0 +1,370 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const char MAGIC[4] = { 'P', 'B', 'I', 'N' };
+
+// Includes nested deeper than this are assumed to be a cycle
+static const int MAX_INCLUDE_DEPTH = 16;
+
+// Layout of a program binary file: this header, then the driver's blob
+struct ProgramBinaryHeader {
+	char magic[4];
+	GLenum format;
+	uint64_t key;
+	uint32_t length;
+	uint32_t padding;
+};
+
+ShaderCache::ShaderCache(const std::string& directoryIn) : directory(directoryIn), binariesSupported(false), parallelCompile(false), firstPending(0), hits(0), misses(0), rejected(0) {
+
+	if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+		directory += '/';
+
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	driver = std::string(vendor ? vendor : "") + "\n" + (renderer ? renderer : "") + "\n" + (version ? version : "");
+
+	// Drivers may support the entry points but expose no binary formats at all
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	binariesSupported = formats > 0 && glGetProgramBinary != nullptr && glProgramBinary != nullptr && glProgramParameteri != nullptr;
+
+	if (binariesSupported) {
+		binaryFormats.resize(formats);
+		glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, binaryFormats.data());
+	}
+
+	// Let the driver use as many compiler threads as it likes
+	parallelCompile = glMaxShaderCompilerThreadsKHR != nullptr &&
+		(hasGLExtension("GL_KHR_parallel_shader_compile") || hasGLExtension("GL_ARB_parallel_shader_compile"));
+	if (parallelCompile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+}
+
+bool ShaderCache::preprocess(const std::string& path, std::string& output, int depth) {
+
+	if (depth > MAX_INCLUDE_DEPTH) {
+		std::cout << "ShaderCache: includes nested too deeply at " << path << std::endl;
+		return false;
+	}
+
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ShaderCache: cannot open " << path << std::endl;
+		return false;
+	}
+
+	size_t slash = path.find_last_of("/\\");
+	std::string folder = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+	std::string line;
+	while (std::getline(file, line)) {
+
+		size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+			size_t open = line.find('"', start + 8);
+			size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				std::cout << "ShaderCache: malformed #include in " << path << std::endl;
+				return false;
+			}
+			if (!preprocess(folder + line.substr(open + 1, close - open - 1), output, depth + 1))
+				return false;
+			continue;
+		}
+
+		output += line;
+		output += '\n';
+	}
+
+	return true;
+}
+
+bool ShaderCache::loadSource(const std::string& path, const Defines& defines, std::string& source) {
+
+	std::string expanded;
+	if (!preprocess(path, expanded, 0))
+		return false;
+
+	// #version has to stay first, so the defines go straight after it
+	size_t versionLine = expanded.find("#version");
+	size_t insertAt = versionLine == std::string::npos ? 0 : expanded.find('\n', versionLine);
+	insertAt = insertAt == std::string::npos ? expanded.size() : insertAt + 1;
+
+	std::string injected;
+	for (const std::pair<std::string, std::string>& define : defines)
+		injected += "#define " + define.first + " " + define.second + "\n";
+
+	// Keep compiler messages pointing at the right line of the file
+	if (!injected.empty() && versionLine != std::string::npos)
+		injected += "#line 2\n";
+
+	source = expanded.substr(0, insertAt) + injected + expanded.substr(insertAt);
+	return true;
+}
+
+GLuint ShaderCache::startCompile(GLenum stage, const std::string& source) {
+	GLuint shader = glCreateShader(stage);
+	const char* text = source.c_str();
+	glShaderSource(shader, 1, &text, nullptr);
+	glCompileShader(shader);
+	return shader;
+}
+
+bool ShaderCache::checkCompile(GLuint shader, const std::string& path) {
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status == GL_TRUE)
+		return true;
+
+	GLint logLength = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	std::vector<char> log(logLength + 1, '\0');
+	glGetShaderInfoLog(shader, logLength, nullptr, log.data());
+	std::cout << "ShaderCache: failed to compile " << path << std::endl << log.data() << std::endl;
+	return false;
+}
+
+std::string ShaderCache::binaryPath(uint64_t key) const {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.progbin", (unsigned long long)key);
+	return directory + name;
+}
+
+bool ShaderCache::loadBinary(uint64_t key, GLuint program) {
+
+	MappedFile file;
+	if (!file.open(binaryPath(key)) || file.size() < sizeof(ProgramBinaryHeader))
+		return false;
+
+	ProgramBinaryHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.key != key || sizeof(header) + (size_t)header.length > file.size())
+		return false;
+
+	if (std::find(binaryFormats.begin(), binaryFormats.end(), (GLint)header.format) == binaryFormats.end()) {
+		rejected++;
+		return false;
+	}
+
+	glProgramBinary(program, header.format, file.data() + sizeof(header), header.length);
+
+	// Drivers are free to refuse any binary, e.g. after an update that kept the version string
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		rejected++;
+		return false;
+	}
+	return true;
+}
+
+void ShaderCache::saveBinary(uint64_t key, GLuint program) {
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	ProgramBinaryHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.key = key;
+	header.padding = 0;
+	glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+	header.length = (uint32_t)length;
+
+	// Best effort; without a writable cache every run compiles from source
+	std::ofstream out(binaryPath(key), std::ios::binary | std::ios::trunc);
+	if (out) {
+		out.write((const char*)&header, sizeof(header));
+		out.write(binary.data(), binary.size());
+	}
+	if (!out)
+		std::cout << "ShaderCache: could not write " << binaryPath(key) << std::endl;
+}
+
+ShaderCache::ProgramId ShaderCache::submit(const std::string& vertexPath, const std::string& fragmentPath, const Defines& defines) {
+
+	Job job;
+	job.vertexPath = vertexPath;
+	job.fragmentPath = fragmentPath;
+
+	std::string vertexSource, fragmentSource;
+	bool loaded = loadSource(vertexPath, defines, vertexSource) && loadSource(fragmentPath, defines, fragmentSource);
+
+	return start(job, loaded, vertexSource, fragmentSource, defines);
+}
+
+ShaderCache::ProgramId ShaderCache::submitCompute(const std::string& computePath, const Defines& defines) {
+
+	Job job;
+	job.vertexPath = computePath;
+
+	std::string computeSource;
+	bool loaded = loadSource(computePath, defines, computeSource);
+
+	return start(job, loaded, computeSource, std::string(), defines);
+}
+
+ShaderCache::ProgramId ShaderCache::start(Job& job, bool loaded, const std::string& vertexSource, const std::string& fragmentSource, const Defines& defines) {
+
+	bool compute = job.fragmentPath.empty();
+
+	job.key = 0;
+	job.program = 0;
+	job.vertexShader = 0;
+	job.fragmentShader = 0;
+	job.error = GLSL_OK;
+	job.done = true;
+
+	ProgramId id = (ProgramId)jobs.size();
+
+	if (!loaded) {
+		job.error = GLSL_SHADER_SOURCE_NOT_FOUND;
+		jobs.push_back(job);
+		return id;
+	}
+
+	job.key = fnv1a64(driver);
+	job.key = fnv1a64(vertexSource, job.key);
+	job.key = fnv1a64(std::string(compute ? "\n--compute--\n" : "\n--fragment--\n"), job.key);
+	job.key = fnv1a64(fragmentSource, job.key);
+	for (const std::pair<std::string, std::string>& define : defines)
+		job.key = fnv1a64(define.first + "=" + define.second + ";", job.key);
+
+	job.program = glCreateProgram();
+
+	if (binariesSupported && loadBinary(job.key, job.program)) {
+		hits++;
+		jobs.push_back(job);
+		return id;
+	}
+
+	misses++;
+
+	// A rejected binary can leave the program in an undefined state; start clean
+	glDeleteProgram(job.program);
+	job.program = glCreateProgram();
+
+	// Compile and link are only queued here. Nothing is queried until
+	// complete(), so the driver is free to work on them in the background.
+	job.vertexShader = startCompile(compute ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER, vertexSource);
+	glAttachShader(job.program, job.vertexShader);
+	if (!compute) {
+		job.fragmentShader = startCompile(GL_FRAGMENT_SHADER, fragmentSource);
+		glAttachShader(job.program, job.fragmentShader);
+	}
+
+	if (binariesSupported)
+		glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(job.program);
+
+	job.done = false;
+	jobs.push_back(job);
+	return id;
+}
+
+bool ShaderCache::complete(Job& job, bool wait) {
+
+	if (job.done)
+		return true;
+
+	if (!wait && parallelCompile) {
+		GLint completed = GL_FALSE;
+		glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &completed);
+		if (completed != GL_TRUE)
+			return false;
+	}
+
+	bool compiled = checkCompile(job.vertexShader, job.vertexPath);
+	if (job.fragmentShader != 0)
+		compiled = checkCompile(job.fragmentShader, job.fragmentPath) && compiled;
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(job.program, GL_LINK_STATUS, &linked);
+
+	if (!compiled) {
+		job.error = GLSL_COMPILER_ERROR;
+	}
+	else if (linked != GL_TRUE) {
+		GLint logLength = 0;
+		glGetProgramiv(job.program, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> log(logLength + 1, '\0');
+		glGetProgramInfoLog(job.program, logLength, nullptr, log.data());
+		std::cout << "ShaderCache: failed to link " << job.vertexPath << (job.fragmentPath.empty() ? "" : " + " + job.fragmentPath) << std::endl << log.data() << std::endl;
+		job.error = GLSL_LINKER_ERROR;
+	}
+
+	glDetachShader(job.program, job.vertexShader);
+	glDeleteShader(job.vertexShader);
+	if (job.fragmentShader != 0) {
+		glDetachShader(job.program, job.fragmentShader);
+		glDeleteShader(job.fragmentShader);
+	}
+	job.vertexShader = 0;
+	job.fragmentShader = 0;
+
+	if (job.error != GLSL_OK) {
+		glDeleteProgram(job.program);
+		job.program = 0;
+	}
+	else if (binariesSupported) {
+		saveBinary(job.key, job.program);
+	}
+
+	job.done = true;
+	return true;
+}
+
+bool ShaderCache::poll() {
+
+	bool allDone = true;
+	for (size_t i = firstPending; i < jobs.size(); i++) {
+		if (!complete(jobs[i], false))
+			allDone = false;
+		else if (allDone)
+			firstPending = i + 1;
+	}
+	return allDone;
+}
+
+bool ShaderCache::poll(ProgramId id) {
+	return complete(jobs[id], false);
+}
+
+void ShaderCache::finish() {
+	for (size_t i = firstPending; i < jobs.size(); i++)
+		complete(jobs[i], true);
+	firstPending = jobs.size();
+}
+
+GLSL_ERROR ShaderCache::createShaderProgram(const std::string& vertexPath, const std::string& fragmentPath, GLuint* program, const Defines& defines) {
+
+	ProgramId id = submit(vertexPath, fragmentPath, defines);
+	complete(jobs[id], true);
+
+	*program = getProgram(id);
+	return getError(id);
+}
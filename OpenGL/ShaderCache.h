@@ -0,0 +1,127 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include "GLExtensions.h"
+#include "ShaderLoader.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// Builds programs from source with #include and #define support, and keeps
+// the linked result as a driver program binary (glGetProgramBinary) so later
+// runs skip compiling and linking.
+//
+// Programs can also be built as a batch: submit() everything up front, then
+// poll() once a frame and draw with a fallback until isReady(). With
+// KHR/ARB_parallel_shader_compile the driver compiles on its own threads and
+// poll() never stalls; without it poll() waits for the outstanding programs.
+//
+// Binaries are keyed by a hash of the preprocessed sources, the defines and
+// the GL vendor, renderer and version strings, so a driver update or any
+// source change simply misses. A binary the driver rejects is rebuilt from
+// source and overwritten.
+class ShaderCache {
+
+public:
+
+	// Name/value pairs, injected as #define lines straight after #version
+	typedef std::vector<std::pair<std::string, std::string>> Defines;
+
+	// Identifies a submitted program
+	typedef unsigned ProgramId;
+
+private:
+
+	// Compute jobs use the vertex fields for the compute stage and leave the fragment ones empty
+	struct Job {
+		std::string vertexPath;
+		std::string fragmentPath;
+		uint64_t key;
+		GLuint program;
+		GLuint vertexShader;	// Held until the link is checked, for the compile log
+		GLuint fragmentShader;
+		GLSL_ERROR error;
+		bool done;
+	};
+
+	std::string directory;
+	std::string driver;			// Vendor, renderer and version; part of every key
+	bool binariesSupported;
+	std::vector<GLint> binaryFormats;
+	bool parallelCompile;
+
+	std::vector<Job> jobs;
+	size_t firstPending;		// Every job before this one is done
+
+	unsigned hits;
+	unsigned misses;
+	unsigned rejected;			// Binaries found but refused by the driver; also counted as misses
+
+	static bool preprocess(const std::string& path, std::string& output, int depth);
+	static GLuint startCompile(GLenum stage, const std::string& source);
+	static bool checkCompile(GLuint shader, const std::string& path);
+
+	// Looks up the binary for job's sources, or starts compiling and linking them
+	ProgramId start(Job& job, bool loaded, const std::string& vertexSource, const std::string& fragmentSource, const Defines& defines);
+
+	// Checks a submitted link; returns false if it is still running and wait is not set
+	bool complete(Job& job, bool wait);
+
+	std::string binaryPath(uint64_t key) const;
+	bool loadBinary(uint64_t key, GLuint program);
+	void saveBinary(uint64_t key, GLuint program);
+
+public:
+
+	// Binaries go in directory, which is created if needed. Context thread only.
+	explicit ShaderCache(const std::string& directory);
+
+	// Same contract as ShaderLoader::createShaderProgram; blocks until linked
+	GLSL_ERROR createShaderProgram(const std::string& vertexPath, const std::string& fragmentPath, GLuint* program, const Defines& defines = Defines());
+
+	// Starts building a program and returns at once. Binary cache hits are ready immediately.
+	ProgramId submit(const std::string& vertexPath, const std::string& fragmentPath, const Defines& defines = Defines());
+
+	// The same for a compute program
+	ProgramId submitCompute(const std::string& computePath, const Defines& defines = Defines());
+
+	// Finishes whatever the driver has completed; true once every submitted program is done
+	bool poll();
+
+	// Finishes one program if the driver has completed it; true once it is done
+	bool poll(ProgramId id);
+
+	// Blocks until every submitted program is done
+	void finish();
+
+	// Done, successfully or not
+	bool isReady(ProgramId id) const {
+		return jobs[id].done;
+	}
+	// 0 until ready, and if the build failed
+	GLuint getProgram(ProgramId id) const {
+		return jobs[id].done ? jobs[id].program : 0;
+	}
+	GLSL_ERROR getError(ProgramId id) const {
+		return jobs[id].error;
+	}
+	bool isParallel() const {
+		return parallelCompile;
+	}
+
+	// Reads path, expands #include "file" (relative to the including file)
+	// and adds defines after the #version line
+	static bool loadSource(const std::string& path, const Defines& defines, std::string& source);
+
+	unsigned getHits() const {
+		return hits;
+	}
+	unsigned getMisses() const {
+		return misses;
+	}
+	unsigned getRejected() const {
+		return rejected;
+	}
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "ShaderVariants.h"
+#include "Light.h"
+
+ShaderVariantKey ShaderVariantKey::fromLights(const LightBuffer& lights, GLuint materialFlags) {
+
+	ShaderVariantKey key;
+	key.materialFlags = materialFlags;
+
+	for (GLuint i = 0; i < lights.size(); i++) {
+
+		const LightRecord& record = lights.get(i);
+		if (record.enabled == 0)
+			continue;
+
+		if (record.type == (GLint)LightType::DIRECTIONAL)
+			key.directionalLights++;
+		else if (record.type == (GLint)LightType::SPOT)
+			key.spotLights = true;
+		else
+			key.bulbLights = true;
+	}
+
+	return key;
+}
+
+ShaderCache::Defines ShaderVariantKey::defines() const {
+	ShaderCache::Defines defines;
+	defines.push_back(std::make_pair(std::string("DIRECTIONAL_LIGHTS"), std::to_string(directionalLights)));
+	defines.push_back(std::make_pair(std::string("BULB_LIGHTS"), std::string(bulbLights ? "1" : "0")));
+	defines.push_back(std::make_pair(std::string("SPOT_LIGHTS"), std::string(spotLights ? "1" : "0")));
+	defines.push_back(std::make_pair(std::string("SPECULAR_MAP"), std::string(materialFlags & MATERIAL_SPECULAR_MAP ? "1" : "0")));
+	defines.push_back(std::make_pair(std::string("SKYBOX_REFLECTION"), std::string(materialFlags & MATERIAL_SKYBOX_REFLECTION ? "1" : "0")));
+	return defines;
+}
+
+ShaderVariants::ShaderVariants(ShaderCache& cacheIn, const std::string& vertexPathIn, const std::string& fragmentPathIn, const ShaderCache::Defines& baseDefinesIn) :
+	cache(cacheIn), vertexPath(vertexPathIn), fragmentPath(fragmentPathIn), baseDefines(baseDefinesIn), selected(-1) {}
+
+int ShaderVariants::find(uint64_t key) const {
+	for (size_t i = 0; i < variants.size(); i++) {
+		if (variants[i].key == key)
+			return (int)i;
+	}
+	return -1;
+}
+
+void ShaderVariants::request(const ShaderVariantKey& key) {
+
+	if (find(key.pack()) >= 0)
+		return;
+
+	ShaderCache::Defines defines = baseDefines;
+	ShaderCache::Defines features = key.defines();
+	defines.insert(defines.end(), features.begin(), features.end());
+
+	Variant variant;
+	variant.key = key.pack();
+	variant.id = cache.submit(vertexPath, fragmentPath, defines);
+	variant.program = 0;
+	variants.push_back(variant);
+}
+
+const ShaderVariants::Variant* ShaderVariants::select(const ShaderVariantKey& key) {
+
+	request(key);
+
+	int index = find(key.pack());
+	Variant& variant = variants[index];
+
+	if (variant.program == 0 && cache.poll(variant.id)) {
+		variant.program = cache.getProgram(variant.id);
+		if (variant.program != 0)
+			variant.uniforms.reflect(variant.program);
+	}
+
+	// A variant that failed to build is never selected; the last good one stays
+	if (variant.program != 0)
+		selected = index;
+
+	return selected >= 0 ? &variants[selected] : nullptr;
+}
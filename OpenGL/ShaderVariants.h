@@ -0,0 +1,88 @@
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include "ShaderCache.h"
+#include "LightBuffer.h"
+#include "UniformTable.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Material features a lit variant can be specialised for
+enum MaterialFlags {
+	MATERIAL_SPECULAR_MAP = 1 << 0,		// texture_specular1 on unit 1
+	MATERIAL_SKYBOX_REFLECTION = 1 << 1	// skybox cube map on unit 2
+};
+
+// Compile-time features of a lit program. Each distinct key is a separate
+// program, so the fragment shader carries no branches on light type or
+// material flags. Bulb and spot counts per fragment come from the light
+// clusters at run time, so only their presence is part of the key; the
+// directional light count is exact so that loop has a fixed trip count.
+struct ShaderVariantKey {
+	GLuint directionalLights;
+	bool bulbLights;
+	bool spotLights;
+	GLuint materialFlags;
+
+	ShaderVariantKey() : directionalLights(0), bulbLights(false), spotLights(false), materialFlags(0) {}
+
+	// Key for the enabled lights in the buffer and the given MaterialFlags
+	static ShaderVariantKey fromLights(const LightBuffer& lights, GLuint materialFlags);
+
+	// DIRECTIONAL_LIGHTS, BULB_LIGHTS, SPOT_LIGHTS, SPECULAR_MAP and SKYBOX_REFLECTION
+	ShaderCache::Defines defines() const;
+
+	uint64_t pack() const {
+		return (uint64_t)directionalLights | (uint64_t)bulbLights << 32 | (uint64_t)spotLights << 33 | (uint64_t)materialFlags << 40;
+	}
+};
+
+// Builds and keeps the specialised programs of one vertex/fragment pair.
+// A variant is compiled the first time its key is asked for, through the
+// ShaderCache batch path, and the previously selected variant keeps drawing
+// until it is ready.
+class ShaderVariants {
+
+public:
+
+	struct Variant {
+		uint64_t key;
+		ShaderCache::ProgramId id;
+		GLuint program;			// 0 until built, and if the build failed
+		UniformTable uniforms;
+	};
+
+private:
+
+	ShaderCache& cache;
+	std::string vertexPath;
+	std::string fragmentPath;
+	ShaderCache::Defines baseDefines;
+
+	std::vector<Variant> variants;
+	int selected;			// Index of the variant last returned by select(), -1 if none
+
+	int find(uint64_t key) const;
+
+public:
+
+	// baseDefines are added to every variant
+	ShaderVariants(ShaderCache& cacheIn, const std::string& vertexPathIn, const std::string& fragmentPathIn, const ShaderCache::Defines& baseDefinesIn = ShaderCache::Defines());
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// Starts building the variant for key if it has not been asked for before
+	void request(const ShaderVariantKey& key);
+
+	// The variant for key once it has built; until then the last variant
+	// selected, or nullptr if there is none yet
+	const Variant* select(const ShaderVariantKey& key);
+
+	size_t getVariantCount() const {
+		return variants.size();
+	}
+};
+
+#endif
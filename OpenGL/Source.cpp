@@ -2,229 +2,370 @@
 #include <utility>
 #include <cmath>
 
+struct Scene;
+
 // Function prototypes
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow* window);
+void processInput(GLFWwindow* window, Scene& scene);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
-void drawSkybox(GLuint vbo, GLuint texture, GLuint shader, glm::mat4 view, glm::mat4 projection);
-glm::vec3 getMatrixPosition(glm::mat4 matrix);
+void drawSkybox(GLuint vao, GLuint texture, GLuint shader);
+void renderScene(Scene& scene, glm::mat4 view, glm::mat4 projection, glm::vec3 eyePos, glm::vec3 lookDirection);
 
-enum class LightType {
-	BULB = 0,
-	DIRECTIONAL = 1,
-	SPOT = 2
-};
+// Camera                      screenWidth, screenHeight, nearPlane, farPlane
+Camera_settings camera_settings{ 1200, 1000, 0.1, 1000.0 };
+Camera camera(camera_settings, glm::vec3(0.0, 5.0, 12.0));
 
-// Classes
-class Light {
+//Timer
+Timer timer;
 
-private:
+double lastX = camera_settings.screenWidth / 2.0f;
+double lastY = camera_settings.screenHeight / 2.0f;
 
-	LightType lightType;
+LightBuffer lightBuffer;
 
-	glm::vec3 position;
-	glm::vec3 colour;
-	glm::vec3 attenuation;
-	glm::vec3 diffuse;
-	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+// Forward (clustered) or deferred lighting; toggled with G
+bool deferredShading = false;
 
-	glm::vec4 ambient = glm::vec4(0.1, 0.1, 0.1, 1.0);
+// CPU occlusion culling behind the VAB and the ground; toggled with O
+bool occlusionCulling = true;
 
-	GLfloat cutOff;
-	GLfloat outerCutOff;
-	GLfloat intensity;
+// Cull and draw the models on the GPU with multi-draw indirect; toggled with I
+bool gpuDriven = false;
 
-public:
+// A marble sphere at every bulb, drawn with one instanced draw; toggled with L
+bool showLightMarkers = false;
 
-	int enabled;
+// Follow the launcher from a camera mounted on it instead of flying freely; toggled with C
+bool chaseCamera = false;
 
-	Light(LightType typeIn, glm::vec3 positionIn, glm::vec3 colourIn, GLfloat intensityIn, glm::vec3 directionIn = glm::vec3(0, -1, 0)) {
-		this->enabled = 1;
-		this->lightType = typeIn;
-		this->setPosition(positionIn);
-		this->setDirection(directionIn);
-		this->setColour(colourIn);
-		this->setIntensity(intensityIn);
-		this->setCutOff(12.5, 17.5);
-		this->setAttenuation(glm::vec3(1.0, 0.09, 0.032f));
-	}
+// Everything the Artemis scene needs on the GPU; built once a GL context is current
+struct Scene {
 
-	void processUniforms(GLuint shader, string lightIndex) {
-
-		glUniform1i(glGetUniformLocation(shader, string(lightIndex + ".enabled").c_str()), this->enabled);
-		glUniform1i(glGetUniformLocation(shader, string(lightIndex + ".type").c_str()), static_cast<GLuint>(this->lightType));
-		glUniform3fv(glGetUniformLocation(shader, string(lightIndex + ".position").c_str()), 1, (GLfloat*)&this->position);
-		glUniform3fv(glGetUniformLocation(shader, string(lightIndex + ".direction").c_str()), 1, (GLfloat*)&this->direction);
-		glUniform3fv(glGetUniformLocation(shader, string(lightIndex + ".colour").c_str()), 1, (GLfloat*)&this->colour);
-		glUniform4fv(glGetUniformLocation(shader, string(lightIndex + ".ambient").c_str()), 1, (GLfloat*)&this->ambient);
-		glUniform1f(glGetUniformLocation(shader, string(lightIndex + ".intensity").c_str()), this->intensity);
-		glUniform3fv(glGetUniformLocation(shader, string(lightIndex + ".diffuse").c_str()), 1, (GLfloat*)&this->diffuse);
-		glUniform3fv(glGetUniformLocation(shader, string(lightIndex + ".attenuation").c_str()), 1, (GLfloat*)&this->attenuation);
-		glUniform1f(glGetUniformLocation(shader, string(lightIndex + ".cutOff").c_str()), this->cutOff);
-		glUniform1f(glGetUniformLocation(shader, string(lightIndex + ".outerCutOff").c_str()), this->outerCutOff);
-	}
+	// Textures and models stream in through this after the first frame
+	AssetLoader assets;
 
-	void setType(LightType typeIn) {
-		this->lightType = typeIn;
-	}
+	//Shaders
+	ShaderCache shaderCache;
+	ShaderVariants basicVariants;	// Lit forward programs, specialised per light set and material
+	ShaderCache::ProgramId skyboxProgram;
+	ShaderCache::ProgramId deferredGeometryProgram;
+	ShaderCache::ProgramId deferredLightProgram;
+	ShaderCache::ProgramId deferredResolveProgram;
+	ShaderCache::ProgramId indirectCullProgram;
+	bool programsReady = false;
+
+	GLuint basicShader = 0;
+	GLuint skyboxShader = 0;
+	GLuint deferredGeometryShader = 0;
+	GLuint fallbackShader = 0;		// Drawn with until basicShader has linked
+
+	UniformTable skyboxUniforms;
+	UniformTable fallbackUniforms;
+	UniformTable deferredUniforms;
+
+	Uniform<GLuint> uObjectIndex;
+	Uniform<GLuint> uFallbackObjectIndex;
+	Uniform<GLfloat> uMatSpecularExp;
+	Uniform<GLuint> uDeferredObjectIndex;
+	Uniform<GLfloat> uDeferredMatSpecularExp;
 
-	void setPosition(glm::vec3 positionIn) {
-		this->position = positionIn;
-	}
-	void setDirection(glm::vec3 directionIn) {
-		this->direction = directionIn;
-	}
-	void setColour(glm::vec3 colourIn) {
-		this->colour = colourIn;
-	}
-	void setIntensity(GLfloat intensityIn) {
-		this->intensity = intensityIn;
-	}
-	void setAttenuation(glm::vec3 attenuationIn) {
-		this->attenuation = attenuationIn;
-	}
-	void setDiffusion(glm::vec3 diffuseIn) {
-		this->diffuse = diffuseIn;
-	}
-	void setCutOff(GLfloat cutOffIn, GLfloat outerCutOffIn) {
-		this->cutOff = glm::cos(glm::radians(cutOffIn));
-		this->outerCutOff = glm::cos(glm::radians(outerCutOffIn));
-	}
+	GLfloat mat_specularExp = 32;
+	GLuint materialFlags = 0;	// MaterialFlags of the lit objects
 
-	LightType getType() {
-		return lightType;
-	}
-	glm::vec3 getPosition() {
-		return position;
-	}
-	GLfloat getIntensity() {
-		return intensity;
-	}
-	glm::vec3 getAttenuation() {
-		return attenuation;
-	}
-	glm::vec3 getDiffusion() {
-		return diffuse;
-	}
-};
+	// Textures
+	GLuint marbleTex;
+	GLuint skyboxTexture;
+	GLuint VABTexture;
 
-// Camera                      screenWidth, screenHeight, nearPlane, farPlane
-Camera_settings camera_settings{ 1200, 1000, 0.1, 1000.0 };
-Camera camera(camera_settings, glm::vec3(0.0, 5.0, 12.0));
+	// Models
+	StaticModel sphere;
+	StaticModel plane;
+	StaticModel SLS;
+	StaticModel ML;
+	StaticModel VAB;
 
-//Timer
-Timer timer;
+	// Camera data shared by every program, and one transform record per drawn object
+	CameraBuffer cameraBuffer;
+	ObjectBuffer objectBuffer;
 
-double lastX = camera_settings.screenWidth / 2.0f;
-double lastY = camera_settings.screenHeight / 2.0f;
+	// Per-cluster light lists read by Basic_shader.frag
+	LightClusters lightClusters;
 
-vector<Light> lights;
-glm::vec3 ML_Position;
-GLfloat ML_heading;
+	// G-buffer and light volumes for the deferred path
+	DeferredRenderer deferred;
 
-int main()
-{
-	float programTime = 0.0;
+	// Everything placed in the scene: models, lights, and the launcher's motion
+	EntityRegistry entities;
+	Entity launcher;
 
-	#pragma region Initialize OpenGL
-	// glfw: initialize and configure
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// Where everything sits; the SLS and its light ride on the launcher
+	SceneGraph graph;
+	GLuint chaseView;
 
+	// Culling, level of detail and sorted draws on the CPU
+	RenderSystem renderer;
 
-	// glfw window creation
-	GLFWwindow* window = glfwCreateWindow(camera_settings.screenWidth, camera_settings.screenHeight, "30003287 - Artemis Generation", NULL, NULL);
-	if (window == NULL)
-	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
+	// Or all of it on the GPU, when gpuDriven is set
+	IndirectRenderer indirect;
+
+	// Light markers, one sphere instance per bulb
+	InstanceBuffer lightMarkers;
+
+	GLuint skyboxVAO;
+	GLuint skyboxVBO;
+
+	Scene();
+	void setupPrograms();
+	void useBasicVariant(const ShaderVariants::Variant& variant);
+	Entity addModel(StaticModel& model, GLuint parentNode, uint32_t renderFlags);
+	void addLight(const Light& light, GLuint node, bool followsView);
+	void updateTransforms();
+	void release();
+};
+
+int main(int argc, char** argv)
+{
+	// "--benchmark [report.json]" replays a scripted camera path offscreen and writes frame timings;
+	// "--deferred" anywhere starts on the deferred path, "--no-occlusion" without occlusion culling,
+	// "--gpu-driven" with GPU culling and multi-draw indirect, "--light-markers" with a sphere on each bulb
+	bool benchmark = argc > 1 && string(argv[1]) == "--benchmark";
+	string reportPath = argc > 2 && argv[2][0] != '-' ? argv[2] : "benchmark_report.json";
+
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--deferred")
+			deferredShading = true;
+		if (string(argv[i]) == "--no-occlusion")
+			occlusionCulling = false;
+		if (string(argv[i]) == "--gpu-driven")
+			gpuDriven = true;
+		if (string(argv[i]) == "--light-markers")
+			showLightMarkers = true;
 	}
 
-	// Set the callback functions
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetScrollCallback(window, scroll_callback);
-	glfwSetKeyCallback(window, key_callback);
+	float programTime = 0.0;
+
+	#pragma region Initialize OpenGL
+	GLFWwindow* window = NULL;
+	HeadlessContext headless;
+
+	if (benchmark) {
+		// No window and no v-sync: frames go to an offscreen framebuffer as fast as they can be drawn
+		if (!headless.create(camera_settings.screenWidth, camera_settings.screenHeight))
+		{
+			std::cout << "Failed to create headless context" << std::endl;
+			return -1;
+		}
+	}
+	else {
+		// glfw: initialize and configure
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+
+		// glfw window creation
+		window = glfwCreateWindow(camera_settings.screenWidth, camera_settings.screenHeight, "30003287 - Artemis Generation", NULL, NULL);
+		if (window == NULL)
+		{
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
 
-	// tell GLFW to capture our mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+		// Set the callback functions
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+		glfwSetKeyCallback(window, key_callback);
+
+		// tell GLFW to capture our mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+
+		// glad: load all OpenGL function pointers
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			return -1;
+		}
+		loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
-	// glad: load all OpenGL function pointers
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		return -1;
+		glfwSwapInterval(1);		// glfw enable swap interval to match screen v-sync
 	}
 
 	//Rendering settings
-	glfwSwapInterval(1);		// glfw enable swap interval to match screen v-sync
 	glEnable(GL_DEPTH_TEST);	//Enables depth testing
 	glEnable(GL_CULL_FACE);		//Enables face culling
 	glFrontFace(GL_CCW);		//Specifies which winding order if front facing
 	#pragma endregion
 
-	//Shaders
-	GLuint basicShader;
-	GLuint skyboxShader;
+	Scene scene;
 
-	// Textures
-	GLuint metalTex;
-	GLuint marbleTex;
-	GLuint skyboxTexture;
-	GLuint VABTexture;
+	if (benchmark) {
+		// Timings should cover the finished scene, not the streaming-in period
+		scene.shaderCache.finish();
+		scene.assets.flush();
+		scene.assets.writeTextureReport(cout);
+		GeometryArena::shared().writeReport(cout);
 
-	// Load shaders
-	GLSL_ERROR glsl_err_basic =
-		ShaderLoader::createShaderProgram(
-			string("Resources\\Shaders\\Basic_shader.vert"),
-			string("Resources\\Shaders\\Basic_shader.frag"),
-			&basicShader
-		);
-	GLSL_ERROR glsl_err_skybox =
-		ShaderLoader::createShaderProgram(
-			string("Resources\\Shaders\\skybox_vert.glsl"),
-			string("Resources\\Shaders\\skybox_frag.glsl"),
-			&skyboxShader
+		Benchmark bench(CameraPath::artemisFlythrough());
+		bench.run(camera.getProjectionMatrix(), [&scene](const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eyePos, const glm::vec3& lookDirection) {
+			renderScene(scene, view, projection, eyePos, lookDirection);
+		});
+		bench.writeReport(reportPath);
+	}
+	else {
+		// render loop
+		while (!glfwWindowShouldClose(window))
+		{
+			cout << programTime << endl;
+
+			// input
+			processInput(window, scene);
+			timer.tick();
+			programTime += timer.getDeltaTimeSeconds();
+
+			updateMovement(scene.entities, (float)timer.getDeltaTimeSeconds());
+
+			string fps = "Avg FPS: " + to_string(int(timer.averageFPS()));
+			string loading = scene.assets.getPendingCount() > 0 ? ", loading " + to_string(scene.assets.getPendingCount()) + " assets" : "";
+			string path = string(deferredShading ? "Deferred, " : "Forward, ") + (gpuDriven && scene.indirect.isReady() ? "GPU-driven, " : "");
+			string windowTitle = "30003287 - Artemis Generation (" + path + fps + loading + ")";
+			glfwSetWindowTitle(window, windowTitle.c_str());
+
+			// Upload whatever the loader threads have finished, within the frame's budget
+			scene.assets.pump();
+
+			frameStats.reset();
+			if (chaseCamera) {
+				// Placed by this frame's launcher position, not the last one
+				scene.updateTransforms();
+				renderScene(scene, scene.graph.getCameraView(scene.chaseView), camera.getProjectionMatrix(), scene.graph.getCameraPosition(scene.chaseView), scene.graph.getCameraDirection(scene.chaseView));
+			}
+			else {
+				renderScene(scene, camera.getViewMatrix(), camera.getProjectionMatrix(), camera.getCameraPosition(), camera.Target);
+			}
+
+			// glfw: swap buffers and poll events
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
+	}
+
+	if (!benchmark) {
+		scene.assets.writeTextureReport(cout);
+		GeometryArena::shared().writeReport(cout);
+	}
+
+	scene.release();
+	lightBuffer.release();
+	GeometryArena::shared().release();
+
+	if (benchmark) {
+		headless.destroy();
+	}
+	else {
+		// glfw: terminate, clearing all previously allocated GLFW resources.
+		glfwTerminate();
+	}
+	return 0;
+}
+
+Scene::Scene() :
+	shaderCache("Resources/Shaders/Cache/"),
+	basicVariants(shaderCache, "Resources/Shaders/Basic_shader.vert", "Resources/Shaders/Basic_shader.frag", LightClusters::shaderDefines())
+{
+	// Block compress colour textures (BC1, or BC3 with alpha) to cut video memory
+	assets.setTextureCompression(true);
+
+	// The ground and the VAB double as occluders for everything else
+	plane.setOccluderBudget(16);
+	VAB.setOccluderBudget(512);
+
+	// Models load on the worker threads and draw nothing until uploaded
+	assets.loadModel(sphere, "Resources/Models/Sphere.obj");
+	assets.loadModel(plane, "Resources/Models/Plane.obj");
+	assets.loadModel(SLS, "Resources/Models/SLS/SLS.obj");
+	assets.loadModel(ML, "Resources/Models/SLS/ML.obj");
+	assets.loadModel(VAB, "Resources/Models/VAB.obj");
+
+	// Load shaders; the cheap fallback is built now, the real programs in the background
+	GLSL_ERROR glsl_err_fallback =
+		shaderCache.createShaderProgram(
+			string("Resources/Shaders/Basic_shader.vert"),
+			string("Resources/Shaders/Fallback.frag"),
+			&fallbackShader
 		);
 
-	// Load textures
-	marbleTex = TextureLoader::loadTexture("Resources\\Models\\marble_texture.jpg");
-	VABTexture = TextureLoader::loadTexture("Resources\\Textures\\VAB_Texture.png");
-	skyboxTexture = TextureLoader::loadCubeMapTexture("Resources\\Textures\\skybox\\moonlit-golf\\", "1024", ".png", GL_RGBA, GL_LINEAR, GL_LINEAR, 8.0F, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, true);
+	if (glsl_err_fallback == GLSL_OK) {
+		fallbackUniforms.reflect(fallbackShader);
+		uFallbackObjectIndex = fallbackUniforms.get<GLuint>("objectIndex");
+	}
+	else {
+		cout << "Failed to build the fallback shader (error " << glsl_err_fallback << "); nothing is drawn until the real programs link" << endl;
+		fallbackShader = 0;
+	}
 
+	skyboxProgram =
+		shaderCache.submit(
+			string("Resources/Shaders/skybox_vert.glsl"),
+			string("Resources/Shaders/skybox_frag.glsl")
+		);
+	deferredGeometryProgram =
+		shaderCache.submit(
+			string("Resources/Shaders/Basic_shader.vert"),
+			string("Resources/Shaders/Deferred_geometry.frag")
+		);
+	deferredLightProgram =
+		shaderCache.submit(
+			string("Resources/Shaders/Deferred_light.vert"),
+			string("Resources/Shaders/Deferred_light.frag")
+		);
+	deferredResolveProgram =
+		shaderCache.submit(
+			string("Resources/Shaders/Fullscreen.vert"),
+			string("Resources/Shaders/Deferred_resolve.frag")
+		);
 
-	// Models
-	Model sphere = Model("Resources\\Models\\Sphere.obj");
-	Model plane = Model("Resources\\Models\\Plane.obj");
-	Model SLS = Model("Resources\\Models\\SLS\\SLS.obj");
-	Model ML = Model("Resources\\Models\\SLS\\ML.obj");
-	Model VAB = Model("Resources\\Models\\VAB.obj");
+	// The GPU-driven path needs GL 4.6 (or ARB_indirect_parameters); without it gpuDriven is ignored
+	if (IndirectRenderer::isSupported())
+		indirectCullProgram = shaderCache.submitCompute(string("Resources/Shaders/Indirect_cull.comp"));
+
+	// Load textures; each name holds a placeholder texel until its image is uploaded
+	marbleTex = assets.loadTexture("Resources/Models/marble_texture.jpg");
+	VABTexture = assets.loadTexture("Resources/Textures/VAB_Texture.png");
+	skyboxTexture = assets.loadCubeMapTexture("Resources/Textures/skybox/moonlit-golf/", "1024", ".png", GL_RGBA, GL_LINEAR, GL_LINEAR, 8.0F, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, true);
 
 	sphere.attachTexture(marbleTex);
 	plane.attachTexture(marbleTex);
 	SLS.attachTexture(marbleTex);
 	VAB.attachTexture(VABTexture);
 
+	// The ground and the VAB hide the launch hardware; the launcher drives from the keyboard
+	addModel(plane, SceneGraph::NONE, RENDER_OCCLUDER);
+	addModel(VAB, SceneGraph::NONE, RENDER_OCCLUDER);
+	launcher = addModel(ML, SceneGraph::NONE, RENDER_OCCLUDABLE);
+	GLuint launcherNode = entities.transforms.get(launcher).node;
+	Entity rocket = addModel(SLS, launcherNode, RENDER_OCCLUDABLE);
 
-	// Lights
-	lights.push_back(Light(LightType::BULB, glm::vec3(5.0, 5.0, 5.0), glm::vec3(0.023, 0.019, 0.301), 1));
-	lights.push_back(Light(LightType::BULB, glm::vec3(-5.0, 5.0, 5.0), glm::vec3(1, 1, 0.0), 1));
-	lights.push_back(Light(LightType::BULB, glm::vec3(5.0, 5.0, -5.0), glm::vec3(1, 1, 1), 1));
+	VelocityComponent still = { 0.0f, 0.0f };
+	entities.velocities.add(launcher, still);
 
-	// Get material unifom locations in shader
-	GLuint uMatAmbient = glGetUniformLocation(basicShader, "matAmbient");
-	GLuint uMatDiffuse = glGetUniformLocation(basicShader, "matDiffuse");
-	GLuint uMatSpecularCol = glGetUniformLocation(basicShader, "matSpecularColour");
-	GLuint uMatSpecularExp = glGetUniformLocation(basicShader, "matSpecularExponent");
+	// Lights: one fixed, one riding on the SLS, one carried by the viewer
+	addLight(Light(lightBuffer, LightType::BULB, glm::vec3(5.0, 5.0, 5.0), glm::vec3(0.023, 0.019, 0.301), 1), SceneGraph::NONE, false);
+	addLight(Light(lightBuffer, LightType::BULB, glm::vec3(-5.0, 5.0, 5.0), glm::vec3(1, 1, 0.0), 1), entities.transforms.get(rocket).node, false);
+	addLight(Light(lightBuffer, LightType::BULB, glm::vec3(5.0, 5.0, -5.0), glm::vec3(1, 1, 1), 1), SceneGraph::NONE, true);
 
-	GLfloat mat_specularExp = 32;
+	// Behind and above the launcher, looking down at it
+	glm::mat4 chaseOffset = glm::inverse(glm::lookAt(glm::vec3(0.0f, 30.0f, 60.0f), glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	chaseView = graph.attachCamera(launcherNode, chaseOffset);
+
+	// Start on the lit variant for these lights alongside the other programs
+	basicVariants.request(ShaderVariantKey::fromLights(lightBuffer, materialFlags));
 
 	#pragma region Skybox
 	float skyboxVertices[] = {
@@ -271,8 +412,6 @@ int main()
 		 1.0f, -1.0f,  1.0f
 	};
 
-	GLuint skyboxVAO, skyboxVBO;
-
 	glGenVertexArrays(1, &skyboxVAO);
 	glGenBuffers(1, &skyboxVBO);
 
@@ -281,102 +420,203 @@ int main()
 	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-	glUseProgram(skyboxShader);
-	glUniform1i(glGetUniformLocation(skyboxShader, "skybox"), 0);
 	#pragma endregion
+}
 
-	
-	int frames = 0;
+// Runs once every submitted program has finished building; a program that
+// failed stays 0 and the fallback (or no skybox) is used in its place
+void Scene::setupPrograms() {
+	skyboxShader = shaderCache.getProgram(skyboxProgram);
+	deferredGeometryShader = shaderCache.getProgram(deferredGeometryProgram);
+	deferred.setPrograms(shaderCache.getProgram(deferredLightProgram), shaderCache.getProgram(deferredResolveProgram));
+	if (IndirectRenderer::isSupported())
+		indirect.setProgram(shaderCache.getProgram(indirectCullProgram));
+	programsReady = true;
+
+	cout << "Shader cache: " << shaderCache.getHits() << " hits, " << shaderCache.getMisses() << " misses (" << shaderCache.getRejected() << " binaries rejected)" << endl;
+
+	// Reflect the linked programs once so the render loop never looks a uniform up by name
+	if (deferredGeometryShader != 0) {
+		deferredUniforms.reflect(deferredGeometryShader);
+		uDeferredObjectIndex = deferredUniforms.get<GLuint>("objectIndex");
+		uDeferredMatSpecularExp = deferredUniforms.get<GLfloat>("matSpecularExponent");
+	}
 
-	// render loop
-	while (!glfwWindowShouldClose(window))
-	{
-		cout << programTime << endl;
+	if (skyboxShader != 0) {
+		skyboxUniforms.reflect(skyboxShader);
 
-		// input
-		processInput(window);
-		timer.tick();
-		programTime += timer.getDeltaTimeSeconds();
+		// The skybox shader predates layout(binding), so its camera block is bound here
+		skyboxUniforms.bindBlock("CameraBlock", CameraBuffer::BINDING);
 
-		string fps = "Avg FPS: " + to_string(int(timer.averageFPS()));
-		string windowTitle = "30003287 - Artemis Generation (" + fps + ")";
-		glfwSetWindowTitle(window, windowTitle.c_str());
+		GLStateCache::shared().useProgram(skyboxShader);
+		skyboxUniforms.get<GLint>("skybox").set(0);
+	}
+}
 
-		// render
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// An entity drawing model at a new node under parentNode, with its own ObjectBuffer record.
+// It joins the GPU-driven path too, once the model has loaded. None of the three can be
+// freed again, so the node, record and entry last as long as the Scene and the entity is
+// never destroyed.
+Entity Scene::addModel(StaticModel& model, GLuint parentNode, uint32_t renderFlags) {
 
-		glm::mat4 identity = glm::mat4(1.0);
-		glm::mat4 view = camera.getViewMatrix();
-		glm::mat4 projection = camera.getProjectionMatrix();
+	Entity entity = entities.create();
 
-		glm::mat4 scaleMat = glm::scale(glm::mat4(1.0), glm::vec3(0.3, 0.3, 0.3));
-		glm::vec3 eyePos = camera.getCameraPosition();
+	TransformComponent transform = { glm::vec3(0.0f), 0.0f, glm::vec3(1.0f), graph.add(parentNode), true };
+	entities.transforms.add(entity, transform);
 
-		drawSkybox(skyboxVAO, skyboxTexture, skyboxShader, view, projection);
+	RenderableComponent renderable = { &model, objectBuffer.add(), renderFlags, ModelDrawState() };
+	entities.renderables.add(entity, renderable);
 
-		glUseProgram(0);
-		glUseProgram(basicShader);
+	graph.attachObject(transform.node, renderable.objectIndex);
+	indirect.add(model, renderable.objectIndex);
+	return entity;
+}
 
-		glUniformMatrix4fv(glGetUniformLocation(basicShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(basicShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniform3fv(glGetUniformLocation(basicShader, "eyePos"), 1, (GLfloat*)&eyePos);
+void Scene::addLight(const Light& light, GLuint node, bool followsView) {
+	LightComponent component = { light, node, glm::vec3(0.0f), followsView };
+	entities.lights.add(entities.create(), component);
+}
 
-		//glUniform3fv(uLightAttenuation, 1, (GLfloat*)&attenuation);
+// Only subtrees that moved are recomputed
+void Scene::updateTransforms() {
+	::updateTransforms(entities, graph, objectBuffer);
+}
 
-		//Pass material data
-		glUniform1f(uMatSpecularExp, mat_specularExp);
+// Moves the forward path onto another lit variant; each variant has its own uniform locations
+void Scene::useBasicVariant(const ShaderVariants::Variant& variant) {
+	basicShader = variant.program;
+	uObjectIndex = variant.uniforms.get<GLuint>("objectIndex");
 
-		float speed = 5.5f;
-		glm::mat4 model = identity * glm::scale(identity, glm::vec3(1, 1.0, 1.0));
-		glUniformMatrix4fv(glGetUniformLocation(basicShader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		plane.draw(basicShader); //Draw the plane
+	// Get material unifom locations in shader
+	uMatSpecularExp = variant.uniforms.get<GLfloat>("matSpecularExponent");
 
-		glUniformMatrix4fv(glGetUniformLocation(basicShader, "model"), 1, GL_FALSE, glm::value_ptr(identity));
-		VAB.draw(basicShader); //Draw the plane
+	GLStateCache::shared().useProgram(basicShader);
+	variant.uniforms.get<GLint>("texture_specular1").set(1);
+	variant.uniforms.get<GLint>("skybox").set(2);
+}
 
-		glm::mat4 MLModel = glm::translate(identity, ML_Position) * glm::rotate(identity, glm::radians(-ML_heading), glm::vec3(0, 1, 0));
-		glUniformMatrix4fv(glGetUniformLocation(basicShader, "model"), 1, GL_FALSE, glm::value_ptr(MLModel));
-		ML.draw(basicShader);
+void Scene::release() {
+	assets.release();
+	glDeleteVertexArrays(1, &skyboxVAO);
+	glDeleteBuffers(1, &skyboxVBO);
+	objectBuffer.release();
+	cameraBuffer.release();
+	lightClusters.release();
+	deferred.release();
+	indirect.release();
+	lightMarkers.release();
+
+	sphere.release();
+	plane.release();
+	SLS.release();
+	ML.release();
+	VAB.release();
+}
 
-		glm::mat4 SLSModel = MLModel * glm::translate(identity, glm::vec3(0.0, 0.0, 0.0));
-		glUniformMatrix4fv(glGetUniformLocation(basicShader, "model"), 1, GL_FALSE, glm::value_ptr(SLSModel));
-		SLS.draw(basicShader);
+// Draws one frame of the scene from the given viewpoint into the bound framebuffer
+void renderScene(Scene& scene, glm::mat4 view, glm::mat4 projection, glm::vec3 eyePos, glm::vec3 lookDirection)
+{
+	// render
+	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		lights[1].setPosition(getMatrixPosition(SLSModel));
+	// Uploads between frames bind textures and VAOs without the state cache
+	GLStateCache& state = GLStateCache::shared();
+	state.invalidate();
 
-		lights[2].setPosition(eyePos);
-		lights[2].setDirection(camera.Target);
+	glm::mat4 identity = glm::mat4(1.0);
 
-		glUniform1i(glGetUniformLocation(basicShader, "lightCount"), lights.size());
-		for (int i = 0; i < lights.size(); i++) {
+	// Switch from the fallback to the real programs as soon as the driver has them
+	if (!scene.programsReady && scene.shaderCache.poll())
+		scene.setupPrograms();
 
-			Light light = lights.at(i);
-			string lightLoc = "Light[" + to_string(i) + "]";
+	// Lit variant for the current lights; the previous one keeps drawing while a new one builds
+	const ShaderVariants::Variant* variant = scene.basicVariants.select(ShaderVariantKey::fromLights(lightBuffer, scene.materialFlags));
+	if (variant != nullptr && variant->program != scene.basicShader)
+		scene.useBasicVariant(*variant);
 
-			/*glm::mat4 model = glm::translate(identity, light.getPosition());
-			glUniformMatrix4fv(glGetUniformLocation(basicShader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-			sphere.draw(basicShader);*/
+	scene.cameraBuffer.update(view, projection, eyePos);
 
-			light.processUniforms(basicShader, lightLoc);
-		}
+	if (scene.skyboxShader != 0)
+		drawSkybox(scene.skyboxVAO, scene.skyboxTexture, scene.skyboxShader);
+
+	// The deferred path stays forward until all of its programs have built
+	bool lit = scene.basicShader != 0;
+	bool deferred = deferredShading && scene.deferredGeometryShader != 0 && scene.deferred.isReady();
+	Uniform<GLuint> objectIndex = deferred ? scene.uDeferredObjectIndex : lit ? scene.uObjectIndex : scene.uFallbackObjectIndex;
+
+	if (deferred)
+		scene.deferred.beginGeometry();
+
+	GLuint drawProgram = deferred ? scene.deferredGeometryShader : lit ? scene.basicShader : scene.fallbackShader;
+
+	// Only when the fallback failed to build and the real programs are still compiling
+	if (drawProgram == 0)
+		return;
 
-		// glfw: swap buffers and poll events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	state.useProgram(drawProgram);
+
+	//Pass material data
+	if (deferred)
+		scene.uDeferredMatSpecularExp.set(scene.mat_specularExp);
+	else
+		scene.uMatSpecularExp.set(scene.mat_specularExp);
+
+	if (lit && !deferred && (scene.materialFlags & MATERIAL_SKYBOX_REFLECTION)) {
+		state.bindTexture(2, GL_TEXTURE_CUBE_MAP, scene.skyboxTexture);
 	}
 
-	glDeleteVertexArrays(1, &skyboxVAO);
-	glDeleteBuffers(1, &skyboxVBO);
+	// Moves the attached objects and lights too
+	scene.updateTransforms();
 
-	// glfw: terminate, clearing all previously allocated GLFW resources.
-	glfwTerminate();
-	return 0;
+	// Update the lights before drawing; only records that changed are re-uploaded
+	updateLights(scene.entities, scene.graph, lightBuffer, eyePos, lookDirection);
+	if (!deferred)
+		scene.lightClusters.update(lightBuffer, view, projection);
+
+	// Only transforms that changed since last frame are re-uploaded
+	scene.objectBuffer.upload();
+
+	float pixelsPerUnit = camera_settings.screenHeight * projection[1][1] * 0.5f;
+
+	if (gpuDriven && scene.indirect.isReady()) {
+		// Culling and level of detail run on the GPU; the pass leaves its own program bound
+		scene.indirect.cull(projection * view, pixelsPerUnit);
+
+		state.useProgram(drawProgram);
+		objectIndex.set((GLuint)IndirectRenderer::INDIRECT_DRAW);
+		scene.indirect.draw();
+	}
+	else {
+		RenderPacket base = RenderPacket();
+		base.program = drawProgram;
+		base.objectIndexLocation = objectIndex.getLocation();
+
+		scene.renderer.draw(scene.entities, scene.graph, projection * view, eyePos, lookDirection, pixelsPerUnit, (float)camera_settings.farPlane, base, occlusionCulling);
+	}
+
+	// Every marker in one draw per sphere mesh, tinted with its bulb's colour
+	if (showLightMarkers && scene.sphere.isLoaded()) {
+		scene.lightMarkers.clear();
+		for (GLuint i = 0; i < scene.entities.lights.size(); i++) {
+			const Light& light = scene.entities.lights.at(i).light;
+			if (light.isEnabled() && light.getType() == LightType::BULB)
+				scene.lightMarkers.add(glm::translate(identity, light.getPosition()) * glm::scale(identity, glm::vec3(0.25f)), glm::vec4(light.getColour(), 1.0f));
+		}
+		scene.lightMarkers.upload();
+
+		state.useProgram(drawProgram);
+		objectIndex.set((GLuint)InstanceBuffer::INSTANCED_DRAW);
+		// The markers are a handful of small spheres, so full detail costs nothing
+		scene.sphere.drawInstanced(scene.lightMarkers, 0);
+	}
+
+	if (deferred)
+		scene.deferred.shade(lightBuffer, projection * view);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void processInput(GLFWwindow* window)
+void processInput(GLFWwindow* window, Scene& scene)
 {
 	timer.updateDeltaTime();
 
@@ -392,29 +632,35 @@ void processInput(GLFWwindow* window)
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.processKeyboard(RIGHT, timer.getDeltaTimeSeconds() * 4);
 
-	// Controlling ML
-	float directionX = sin(ML_heading * 3.1415965 / 180.0);
-	float directionZ = -cos(ML_heading * 3.1415965 / 180.0);
-
-
-	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
-		ML_Position.x += directionX;
-		ML_Position.z += directionZ;
-	}
+	// Controlling ML: the keys set its velocity and updateMovement() moves it.
+	// 60 units a second is the unit per frame it used to move at with v-sync.
+	VelocityComponent& launcher = scene.entities.velocities.get(scene.launcher);
+	launcher.forward = 0.0f;
+	launcher.turn = 0.0f;
 
-	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-		ML_Position.x -= directionX;
-		ML_Position.z -= directionZ;
-	}
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+		launcher.forward += 60.0f;
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+		launcher.forward -= 60.0f;
 
 	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		ML_heading -= timer.getDeltaTimeSeconds() * 100;
+		launcher.turn -= 100.0f;
 	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		ML_heading += timer.getDeltaTimeSeconds() * 100;
+		launcher.turn += 100.0f;
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+		deferredShading = !deferredShading;
+	if (key == GLFW_KEY_O && action == GLFW_PRESS)
+		occlusionCulling = !occlusionCulling;
+	if (key == GLFW_KEY_I && action == GLFW_PRESS)
+		gpuDriven = !gpuDriven;
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+		showLightMarkers = !showLightMarkers;
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+		chaseCamera = !chaseCamera;
 
 }
 
@@ -447,27 +693,22 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	camera.processMouseScroll(yoffset);
 }
 
-void drawSkybox(GLuint vao, GLuint texture, GLuint shader, glm::mat4 view, glm::mat4 projection) {
+void drawSkybox(GLuint vao, GLuint texture, GLuint shader) {
 	
+	GLStateCache& state = GLStateCache::shared();
+
 	// Disable depth masking
-	glDepthMask(GL_FALSE);
+	state.depthMask(GL_FALSE);
 
-	glUseProgram(shader);
-	view = glm::mat4(glm::mat3(camera.getViewMatrix()));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	// View and projection come from the shared camera block
+	state.useProgram(shader);
 
 	// Render the skybox cube
-	glBindVertexArray(vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	state.bindVertexArray(vao);
+	state.bindTexture(0, GL_TEXTURE_CUBE_MAP, texture);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
+	frameStats.drawCalls++;
 
 	// Re-enable depth mask
-	glDepthMask(GL_TRUE);
-}
-
-glm::vec3 getMatrixPosition(glm::mat4 matrix) {
-	return matrix[3];
+	state.depthMask(GL_TRUE);
 }
\ No newline at end of file
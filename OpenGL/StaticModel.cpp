@@ -0,0 +1,213 @@
+#include "StaticModel.h"
+#include "FrameStats.h"
+#include "GLStateCache.h"
+#include "TextureLoader.h"
+#include <assimp/postprocess.h>
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+const uint32_t StaticModel::IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices | aiProcess_PreTransformVertices;
+const uint32_t StaticModel::CACHE_OPTIONS = MeshCache::OPTIMIZE_VERTEX_CACHE | MeshCache::OPTIMIZE_OVERDRAW | MeshCache::OPTIMIZE_VERTEX_FETCH | MeshCache::QUANTIZE_VERTICES;
+
+const float StaticModel::LOD_PIXEL_ERROR = 1.0f;
+const float StaticModel::LOD_HYSTERESIS = 0.75f;
+
+static MeshBounds toBounds(const float* boundsMin, const float* boundsMax) {
+	MeshBounds bounds;
+	bounds.min = glm::vec3(boundsMin[0], boundsMin[1], boundsMin[2]);
+	bounds.max = glm::vec3(boundsMax[0], boundsMax[1], boundsMax[2]);
+	bounds.sphereCentre = (bounds.min + bounds.max) * 0.5f;
+	bounds.sphereRadius = glm::length(bounds.max - bounds.min) * 0.5f;
+	return bounds;
+}
+
+StaticModel::StaticModel() : attachedTexture(0), occluderBudget(0) {
+	bounds = MeshBounds();
+}
+
+StaticModel::StaticModel(const std::string& path) : attachedTexture(0), occluderBudget(0) {
+
+	bounds = MeshBounds();
+
+	MeshCacheImage image;
+	if (!MeshCache::load(path, IMPORT_FLAGS, CACHE_OPTIONS, image)) {
+		std::cout << "StaticModel: failed to load " << path << std::endl;
+		return;
+	}
+
+	upload(image, path, [](const std::string& texturePath) { return TextureLoader::loadTexture(texturePath); });
+}
+
+void StaticModel::upload(const MeshCacheImage& image, const std::string& sourcePath, const TextureSource& loadTexture) {
+
+	size_t slash = sourcePath.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? std::string() : sourcePath.substr(0, slash + 1);
+
+	const MeshCacheHeader& header = image.header();
+	bounds = toBounds(header.boundsMin, header.boundsMax);
+
+	if (occluderBudget > 0)
+		occluder = OccluderMesh::fromImage(image, occluderBudget);
+
+	for (uint32_t i = 0; i < header.materialCount; i++) {
+		const MeshCacheMaterial& material = image.material(i);
+		materialTextures.push_back(material.diffuseTexture[0] != '\0' ? loadTexture(directory + material.diffuseTexture) : 0);
+	}
+
+	meshes.resize(header.meshCount);
+
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+
+		const MeshCacheMesh& source = image.mesh(i);
+		StaticMesh& mesh = meshes[i];
+
+		mesh.indexCount = source.indexCount;
+		mesh.materialIndex = source.materialIndex;
+		mesh.bounds = toBounds(source.boundsMin, source.boundsMax);
+		mesh.bounds.sphereCentre = glm::vec3(source.sphereCentre[0], source.sphereCentre[1], source.sphereCentre[2]);
+		mesh.bounds.sphereRadius = source.sphereRadius;
+
+		mesh.lodCount = source.lodCount;
+		GLuint blockCount = 0;
+		for (GLuint level = 0; level < source.lodCount; level++) {
+			mesh.lods[level].firstIndex = source.lods[level].firstIndex;
+			mesh.lods[level].indexCount = source.lods[level].indexCount;
+			mesh.lods[level].error = source.lods[level].error;
+			blockCount = std::max(blockCount, source.lods[level].firstIndex + source.lods[level].indexCount);
+		}
+
+		// Straight from the (possibly mapped) cache image; no staging copies. Every level shares the vertices.
+		mesh.geometry = GeometryArena::shared().allocate(source.vertexFormat, image.vertexData(i), source.vertexCount, image.indices(i), blockCount);
+
+		if (source.vertexFormat == MESH_VERTEX_PACKED) {
+			mesh.decodeScale = glm::vec4(source.positionScale[0], source.positionScale[1], source.positionScale[2], 1.0f);
+			mesh.decodeOffset = glm::vec3(source.positionOffset[0], source.positionOffset[1], source.positionOffset[2]);
+		} else {
+			mesh.decodeScale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+			mesh.decodeOffset = glm::vec3(0.0f);
+		}
+	}
+}
+
+void StaticModel::attachTexture(GLuint texture) {
+	attachedTexture = texture;
+}
+
+void StaticModel::queueCulling(ModelDrawState& state, FrustumCuller& culler, const glm::mat4& transform) const {
+	state.cullSlot = culler.size();
+	for (const StaticMesh& mesh : meshes)
+		culler.add(mesh.bounds.min, mesh.bounds.max, transform);
+}
+
+void StaticModel::selectLod(ModelDrawState& state, const glm::mat4& transform, const glm::vec3& eyePos, float pixelsPerUnit) const {
+
+	GLuint levelCount = 0;
+	for (const StaticMesh& mesh : meshes)
+		levelCount = std::max(levelCount, mesh.lodCount);
+	if (levelCount == 0)
+		return;
+
+	// Distance to the nearest point of the bounding sphere, under the largest scale in transform
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	glm::vec3 centre = glm::vec3(transform * glm::vec4(bounds.sphereCentre, 1.0f));
+	float distance = glm::length(centre - eyePos) - bounds.sphereRadius * scale;
+	if (distance <= 0.0f) {
+		state.lod = 0;
+		return;
+	}
+
+	// Worst mesh error at a level, in pixels
+	float pixelsPerError = pixelsPerUnit * scale / distance;
+	auto screenError = [this, pixelsPerError](GLuint level) {
+		float error = 0.0f;
+		for (const StaticMesh& mesh : meshes)
+			error = std::max(error, mesh.lods[std::min(level, mesh.lodCount - 1)].error);
+		return error * pixelsPerError;
+	};
+
+	GLuint level = std::min(state.lod, levelCount - 1);
+	while (level > 0 && screenError(level) > LOD_PIXEL_ERROR)
+		level--;
+	while (level + 1 < levelCount && screenError(level + 1) <= LOD_PIXEL_ERROR * LOD_HYSTERESIS)
+		level++;
+	state.lod = level;
+}
+
+void StaticModel::drawInstanced(const InstanceBuffer& instances, GLuint lod) const {
+
+	if (instances.size() == 0)
+		return;
+
+	instances.bind();
+
+	const GeometryArena& arena = GeometryArena::shared();
+	GLStateCache& state = GLStateCache::shared();
+
+	for (GLuint i = 0; i < meshes.size(); i++) {
+
+		const StaticMesh& mesh = meshes[i];
+		const MeshLod& level = mesh.lods[std::min(lod, mesh.lodCount - 1)];
+
+		state.bindTexture(0, GL_TEXTURE_2D, getMeshTexture(i));
+		state.bindVertexArray(arena.getVertexArray(mesh.geometry.format));
+
+		glVertexAttrib4f(GeometryArena::DECODE_SCALE_LOCATION, mesh.decodeScale.x, mesh.decodeScale.y, mesh.decodeScale.z, mesh.decodeScale.w);
+		glVertexAttrib3f(GeometryArena::DECODE_OFFSET_LOCATION, mesh.decodeOffset.x, mesh.decodeOffset.y, mesh.decodeOffset.z);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void*)((size_t)(mesh.geometry.firstIndex + level.firstIndex) * sizeof(uint32_t)), instances.size(), mesh.geometry.baseVertex);
+
+		frameStats.drawCalls++;
+		frameStats.triangles += level.indexCount / 3 * instances.size();
+	}
+}
+
+void StaticModel::submit(const ModelDrawState& state, RenderQueue& queue, RenderQueue::Pass pass, const RenderPacket& base, const glm::mat4& transform, const glm::vec3& eyePos, const glm::vec3& viewDirection, const FrustumCuller* culler) const {
+
+	const GeometryArena& arena = GeometryArena::shared();
+
+	for (GLuint i = 0; i < meshes.size(); i++) {
+
+		const StaticMesh& mesh = meshes[i];
+		const MeshLod& level = mesh.lods[std::min(state.lod, mesh.lodCount - 1)];
+
+		if (culler != nullptr && !culler->isVisible(state.cullSlot + i)) {
+			frameStats.culledObjects++;
+			frameStats.culledTriangles += level.indexCount / 3;
+			continue;
+		}
+
+		RenderPacket packet = base;
+		packet.texture = getMeshTexture(i);
+		packet.vertexArray = arena.getVertexArray(mesh.geometry.format);
+		packet.decodeScale = mesh.decodeScale;
+		packet.decodeOffset = mesh.decodeOffset;
+		packet.indexCount = level.indexCount;
+		packet.firstIndex = mesh.geometry.firstIndex + level.firstIndex;
+		packet.baseVertex = mesh.geometry.baseVertex;
+
+		glm::vec3 centre = glm::vec3(transform * glm::vec4(mesh.bounds.sphereCentre, 1.0f));
+		queue.submit(pass, glm::dot(centre - eyePos, viewDirection), packet);
+	}
+}
+
+GLuint StaticModel::getMeshTexture(GLuint mesh) const {
+	GLuint texture = attachedTexture;
+	if (texture == 0 && meshes[mesh].materialIndex < materialTextures.size())
+		texture = materialTextures[meshes[mesh].materialIndex];
+	return texture;
+}
+
+void StaticModel::release() {
+
+	for (const StaticMesh& mesh : meshes)
+		GeometryArena::shared().free(mesh.geometry);
+	meshes.clear();
+
+	for (GLuint texture : materialTextures) {
+		if (texture != 0)
+			glDeleteTextures(1, &texture);
+	}
+	materialTextures.clear();
+
+	occluder = OccluderMesh();
+}
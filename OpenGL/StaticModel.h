@@ -0,0 +1,144 @@
+#ifndef STATICMODEL_H
+#define STATICMODEL_H
+
+#include "MeshCache.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "GeometryArena.h"
+#include "InstanceBuffer.h"
+#include "RenderQueue.h"
+#include "GLExtensions.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+struct MeshBounds {
+	glm::vec3 min;
+	glm::vec3 max;
+	glm::vec3 sphereCentre;
+	float sphereRadius;
+};
+
+// Index range of one level of detail in the mesh's element buffer
+struct MeshLod {
+	GLuint firstIndex;
+	GLuint indexCount;
+	float error;	// Largest distance from the full mesh, in model units
+};
+
+struct StaticMesh {
+	GeometryArena::Allocation geometry;	// Vertices and every level's indices
+	GLuint indexCount;	// Full detail
+	GLuint materialIndex;
+	MeshBounds bounds;
+	GLuint lodCount;
+	MeshLod lods[MESH_MAX_LODS];
+	glm::vec4 decodeScale;	// Position scale; w is 1 for octahedral normals
+	glm::vec3 decodeOffset;
+};
+
+// What one placement of a model carries from frame to frame: the level of
+// detail it is drawn at (which selection's hysteresis starts from) and where
+// its meshes sit in this frame's FrustumCuller
+struct ModelDrawState {
+	GLuint cullSlot;	// FrustumCuller slot of the first mesh this frame
+	GLuint lod;	// Level of detail drawn, 0 being full detail
+
+	ModelDrawState() : cullSlot(0), lod(0) {}
+};
+
+// Static geometry loaded through the MeshCache. Warm starts map the cache and
+// copy it straight into the shared GeometryArena, so Assimp is only involved
+// when the source file or import flags change.
+class StaticModel {
+
+private:
+
+	std::vector<StaticMesh> meshes;
+	std::vector<GLuint> materialTextures;	// Diffuse texture per material, 0 if none
+	GLuint attachedTexture;
+	MeshBounds bounds;
+	GLuint occluderBudget;	// Triangles kept for the occluder, 0 for none
+	OccluderMesh occluder;
+
+public:
+
+	// Resolves a material texture path to a texture name
+	typedef std::function<GLuint(const std::string&)> TextureSource;
+
+	// Flags handed to Assimp on a cache miss; part of the cache key
+	static const uint32_t IMPORT_FLAGS;
+
+	// MeshCache::OPTIMIZE_* stages run on a cache miss; also part of the cache key
+	static const uint32_t CACHE_OPTIONS;
+
+	// Coarsest level whose error stays under this many pixels is drawn
+	static const float LOD_PIXEL_ERROR;
+
+	// A coarser level is only taken once its error falls to this fraction of
+	// LOD_PIXEL_ERROR, so objects near a threshold do not flip every frame
+	static const float LOD_HYSTERESIS;
+
+	// Empty until upload() runs; draws nothing in the meantime
+	StaticModel();
+
+	// Loads and uploads synchronously
+	StaticModel(const std::string& path);
+
+	// Copies an image loaded for sourcePath into the arena. Context thread only.
+	void upload(const MeshCacheImage& image, const std::string& sourcePath, const TextureSource& loadTexture);
+
+	StaticModel(const StaticModel&) = delete;
+	StaticModel& operator=(const StaticModel&) = delete;
+
+	// Keeps up to maxTriangles of the largest triangles as an occluder when the
+	// model is uploaded; call before loading
+	void setOccluderBudget(GLuint maxTriangles) {
+		occluderBudget = maxTriangles;
+	}
+
+	// Overrides every material's diffuse texture
+	void attachTexture(GLuint texture);
+
+	// The calls below take a ModelDrawState so one model can be placed many
+	// times a frame, each placement keeping its own level and cull slot.
+
+	// Picks the placement's level of detail from the projected error. pixelsPerUnit is
+	// the size on screen of one unit at distance one: viewport height * projection[1][1] / 2.
+	void selectLod(ModelDrawState& state, const glm::mat4& transform, const glm::vec3& eyePos, float pixelsPerUnit) const;
+
+	// Queues each mesh's bounds under transform; call between FrustumCuller::begin() and run()
+	void queueCulling(ModelDrawState& state, FrustumCuller& culler, const glm::mat4& transform) const;
+
+	// Queues every mesh the culler kept at the placement's level of detail.
+	// base supplies the program and objectIndex; each mesh is keyed on its
+	// bounding sphere's distance along viewDirection. culler may be null.
+	// Textures go to unit 0 (texture_diffuse1).
+	void submit(const ModelDrawState& state, RenderQueue& queue, RenderQueue::Pass pass, const RenderPacket& base, const glm::mat4& transform, const glm::vec3& eyePos, const glm::vec3& viewDirection, const FrustumCuller* culler) const;
+
+	// Draws every mesh once per record in instances, which must be uploaded, with
+	// one instanced draw per mesh at level lod (0 being full detail). The bound
+	// program's objectIndex must be InstanceBuffer::INSTANCED_DRAW.
+	void drawInstanced(const InstanceBuffer& instances, GLuint lod) const;
+
+	// Returns the geometry to the arena and frees the textures; must run before the context is destroyed
+	void release();
+
+	bool isLoaded() const {
+		return !meshes.empty();
+	}
+	const std::vector<StaticMesh>& getMeshes() const {
+		return meshes;
+	}
+	const MeshBounds& getBounds() const {
+		return bounds;
+	}
+	const OccluderMesh& getOccluder() const {
+		return occluder;
+	}
+
+	// The attached texture, or else the mesh's material texture
+	GLuint getMeshTexture(GLuint mesh) const;
+};
+
+#endif
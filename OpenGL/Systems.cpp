@@ -0,0 +1,117 @@
+#include "Systems.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+void updateMovement(EntityRegistry& registry, float deltaSeconds) {
+
+	ComponentPool<VelocityComponent>& velocities = registry.velocities;
+
+	for (uint32_t i = 0; i < velocities.size(); i++) {
+
+		const VelocityComponent& velocity = velocities.at(i);
+		if (velocity.forward == 0.0f && velocity.turn == 0.0f)
+			continue;
+
+		TransformComponent* transform = registry.transforms.find(velocities.entityAt(i));
+		if (transform == nullptr)
+			continue;
+
+		float heading = glm::radians(transform->heading);
+		transform->position += glm::vec3(sinf(heading), 0.0f, -cosf(heading)) * (velocity.forward * deltaSeconds);
+		transform->heading += velocity.turn * deltaSeconds;
+		transform->dirty = true;
+	}
+}
+
+void updateTransforms(EntityRegistry& registry, SceneGraph& graph, ObjectBuffer& objectBuffer) {
+
+	ComponentPool<TransformComponent>& transforms = registry.transforms;
+	glm::mat4 identity = glm::mat4(1.0);
+
+	for (uint32_t i = 0; i < transforms.size(); i++) {
+
+		TransformComponent& transform = transforms.at(i);
+		if (!transform.dirty)
+			continue;
+
+		graph.setLocal(transform.node,
+			glm::translate(identity, transform.position) * glm::rotate(identity, glm::radians(-transform.heading), glm::vec3(0, 1, 0)) * glm::scale(identity, transform.scale));
+		transform.dirty = false;
+	}
+
+	graph.update(objectBuffer);
+}
+
+void updateLights(EntityRegistry& registry, const SceneGraph& graph, LightBuffer& lightBuffer, const glm::vec3& eyePos, const glm::vec3& viewDirection) {
+
+	ComponentPool<LightComponent>& lights = registry.lights;
+
+	// The setters only mark a record dirty when its value actually changes
+	for (uint32_t i = 0; i < lights.size(); i++) {
+
+		LightComponent& component = lights.at(i);
+
+		if (component.followsView) {
+			component.light.setPosition(eyePos);
+			component.light.setDirection(viewDirection);
+		}
+		else if (component.node != SceneGraph::NONE) {
+			component.light.setPosition(glm::vec3(graph.getWorld(component.node) * glm::vec4(component.localPosition, 1.0f)));
+		}
+	}
+
+	lightBuffer.upload();
+}
+
+void RenderSystem::draw(EntityRegistry& registry, const SceneGraph& graph, const glm::mat4& viewProjection, const glm::vec3& eyePos, const glm::vec3& viewDirection,
+	float pixelsPerUnit, float farDistance, const RenderPacket& base, bool occlusionCulling) {
+
+	ComponentPool<RenderableComponent>& renderables = registry.renderables;
+	const ComponentPool<TransformComponent>& transforms = registry.transforms;
+
+	// Renderables without a transform have nowhere to be drawn, so every pass skips them
+	placed.clear();
+	for (uint32_t i = 0; i < renderables.size(); i++) {
+		const TransformComponent* transform = transforms.find(renderables.entityAt(i));
+		if (transform != nullptr) {
+			Placement placement = { i, &graph.getWorld(transform->node) };
+			placed.push_back(placement);
+		}
+	}
+
+	// Level of detail from each entity's projected error, and every mesh against the view frustum in one pass
+	culler.begin(viewProjection);
+	for (const Placement& placement : placed) {
+		RenderableComponent& renderable = renderables.at(placement.slot);
+		renderable.model->selectLod(renderable.drawState, *placement.world, eyePos, pixelsPerUnit);
+		renderable.model->queueCulling(renderable.drawState, culler, *placement.world);
+	}
+	culler.run();
+
+	// Then hide the occludable entities wherever an occluder covers them
+	if (occlusionCulling) {
+		occlusion.begin(viewProjection);
+		for (const Placement& placement : placed) {
+			const RenderableComponent& renderable = renderables.at(placement.slot);
+			if (renderable.flags & RENDER_OCCLUDER)
+				occlusion.addOccluder(renderable.model->getOccluder(), *placement.world);
+		}
+		occlusion.rasterize();
+
+		for (const Placement& placement : placed) {
+			const RenderableComponent& renderable = renderables.at(placement.slot);
+			if (renderable.flags & RENDER_OCCLUDABLE)
+				occlusion.cull(culler, renderable.drawState.cullSlot, (GLuint)renderable.model->getMeshes().size());
+		}
+	}
+
+	queue.begin(farDistance);
+
+	RenderPacket packet = base;
+	for (const Placement& placement : placed) {
+		const RenderableComponent& renderable = renderables.at(placement.slot);
+		packet.objectIndex = renderable.objectIndex;
+		renderable.model->submit(renderable.drawState, queue, RenderQueue::PASS_OPAQUE, packet, *placement.world, eyePos, viewDirection, &culler);
+	}
+
+	queue.execute();
+}
@@ -0,0 +1,56 @@
+#ifndef SYSTEMS_H
+#define SYSTEMS_H
+
+#include "EntityRegistry.h"
+#include "SceneGraph.h"
+#include "LightBuffer.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include <vector>
+
+// Systems run once per frame, in this order, over EntityRegistry's dense
+// component arrays.
+
+// Advances every entity with a velocity along its heading
+void updateMovement(EntityRegistry& registry, float deltaSeconds);
+
+// Writes the transforms that changed into their SceneGraph nodes and updates
+// the graph, which moves the attached ObjectBuffer records
+void updateTransforms(EntityRegistry& registry, SceneGraph& graph, ObjectBuffer& objectBuffer);
+
+// Places the lights on their nodes (or at the eye) and uploads the ones that changed
+void updateLights(EntityRegistry& registry, const SceneGraph& graph, LightBuffer& lightBuffer, const glm::vec3& eyePos, const glm::vec3& viewDirection);
+
+// Draws every renderable on the CPU path: level of detail, frustum culling,
+// occlusion culling between RENDER_OCCLUDER and RENDER_OCCLUDABLE entities,
+// then one sorted RenderQueue. Entities without a TransformComponent are skipped.
+class RenderSystem {
+
+private:
+
+	// A renderable with a transform, and where its node sits this frame
+	struct Placement {
+		uint32_t slot;	// In the renderable pool
+		const glm::mat4* world;
+	};
+
+	FrustumCuller culler;
+	OcclusionCuller occlusion;
+	RenderQueue queue;
+	std::vector<Placement> placed;
+
+public:
+
+	RenderSystem() {}
+
+	RenderSystem(const RenderSystem&) = delete;
+	RenderSystem& operator=(const RenderSystem&) = delete;
+
+	// base supplies the program and objectIndex location; the CameraBuffer
+	// and ObjectBuffer must be up to date
+	void draw(EntityRegistry& registry, const SceneGraph& graph, const glm::mat4& viewProjection, const glm::vec3& eyePos, const glm::vec3& viewDirection,
+		float pixelsPerUnit, float farDistance, const RenderPacket& base, bool occlusionCulling);
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "TextureCache.h"
+#include "Hash.h"
+#include "MipGenerator.h"
+#include "BlockEncoder.h"
+#include "GLExtensions.h"
+#include <stb_image.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char MAGIC[4] = { 'T', 'X', 'C', 'H' };
+
+static size_t alignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+std::string TextureCache::cachePath(const std::string& sourcePath) {
+	return sourcePath + ".texcache";
+}
+
+size_t TextureCache::levelSize(const TextureCacheHeader& header, uint32_t width, uint32_t height) {
+
+	if (!isCompressed(header))
+		return header.internalFormat == GL_RGBA8 && header.format == GL_RGBA && header.type == GL_UNSIGNED_BYTE ? (size_t)width * height * 4 : 0;
+
+	switch (header.internalFormat) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		return BlockEncoder::encodedSize(BlockFormat::BC1, width, height);
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return BlockEncoder::encodedSize(BlockFormat::BC3, width, height);
+	case GL_COMPRESSED_RG_RGTC2:
+		return BlockEncoder::encodedSize(BlockFormat::BC5, width, height);
+	default:
+		return 0;
+	}
+}
+
+bool TextureCache::validate(const TextureCacheImage& image, uint64_t sourceHash, uint32_t flags) {
+
+	if (image.length < sizeof(TextureCacheHeader))
+		return false;
+
+	const TextureCacheHeader& header = image.header();
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		header.version != VERSION ||
+		header.sourceHash != sourceHash ||
+		header.flags != flags ||
+		header.levelCount == 0)
+		return false;
+
+	if (header.levelOffset + (uint64_t)header.levelCount * sizeof(TextureCacheLevel) > image.length)
+		return false;
+
+	if (header.width == 0 || header.height == 0 || header.levelCount != MipGenerator::levelCount(header.width, header.height))
+		return false;
+
+	// Uploads read each level's full extent straight from the mapping, and
+	// stage the chain as one range from the first level to the end of the last
+	uint64_t end = 0;
+	for (uint32_t i = 0; i < header.levelCount; i++) {
+		const TextureCacheLevel& level = image.level(i);
+		if (level.width != MipGenerator::levelSize(header.width, i) ||
+			level.height != MipGenerator::levelSize(header.height, i))
+			return false;
+
+		size_t size = levelSize(header, level.width, level.height);
+		if (size == 0 || level.size != size ||
+			level.offset < end ||
+			level.offset + (uint64_t)level.size > image.length)
+			return false;
+
+		end = level.offset + level.size;
+	}
+
+	return true;
+}
+
+bool TextureCache::build(const std::string& sourcePath, const unsigned char* source, size_t sourceSize, uint64_t sourceHash, uint32_t flags, TextureCacheImage& image) {
+
+	int width, height, channels;
+	unsigned char* pixels = stbi_load_from_memory(source, (int)sourceSize, &width, &height, &channels, 4);
+	if (pixels == nullptr) {
+		std::cout << "TextureCache: failed to decode " << sourcePath << std::endl;
+		return false;
+	}
+
+	uint32_t levelCount = MipGenerator::levelCount(width, height);
+
+	// The RGBA8 chain comes first; compressed caches encode from it afterwards
+	std::vector<size_t> chainOffsets(levelCount);
+	size_t chainSize = 0;
+	for (uint32_t i = 0; i < levelCount; i++) {
+		chainOffsets[i] = chainSize;
+		chainSize += (size_t)MipGenerator::levelSize(width, i) * MipGenerator::levelSize(height, i) * 4;
+	}
+
+	std::vector<unsigned char> chain(chainSize);
+	memcpy(chain.data(), pixels, (size_t)width * height * 4);
+	stbi_image_free(pixels);
+
+	// Each level is filtered from the one above it
+	bool srgb = (flags & SRGB) != 0 && (flags & NORMAL_MAP) == 0;
+	for (uint32_t i = 1; i < levelCount; i++)
+		MipGenerator::downsample(chain.data() + chainOffsets[i - 1], MipGenerator::levelSize(width, i - 1), MipGenerator::levelSize(height, i - 1), chain.data() + chainOffsets[i], srgb);
+
+	bool compress = (flags & COMPRESS) != 0;
+	BlockFormat blockFormat = BlockFormat::BC1;
+	GLenum internalFormat = GL_RGBA8;
+
+	if (compress) {
+		if (flags & NORMAL_MAP)
+			blockFormat = BlockFormat::BC5;
+		else if (!BlockEncoder::isOpaque(chain.data(), width, height))
+			blockFormat = BlockFormat::BC3;
+
+		internalFormat = blockFormat == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT :
+			blockFormat == BlockFormat::BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RG_RGTC2;
+	}
+
+	size_t levelOffset = alignUp(sizeof(TextureCacheHeader), 16);
+	size_t cursor = alignUp(levelOffset + levelCount * sizeof(TextureCacheLevel), 16);
+
+	std::vector<size_t> offsets(levelCount);
+	std::vector<size_t> sizes(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		uint32_t levelWidth = MipGenerator::levelSize(width, i);
+		uint32_t levelHeight = MipGenerator::levelSize(height, i);
+		sizes[i] = compress ? BlockEncoder::encodedSize(blockFormat, levelWidth, levelHeight) : (size_t)levelWidth * levelHeight * 4;
+		offsets[i] = cursor;
+		cursor = alignUp(cursor + sizes[i], 16);
+	}
+
+	std::vector<unsigned char>& memory = image.memory;
+	memory.assign(cursor, 0);
+
+	TextureCacheHeader* header = (TextureCacheHeader*)memory.data();
+	memcpy(header->magic, MAGIC, sizeof(MAGIC));
+	header->version = VERSION;
+	header->sourceHash = sourceHash;
+	header->flags = flags;
+	header->width = width;
+	header->height = height;
+	header->levelCount = levelCount;
+	header->internalFormat = internalFormat;
+	header->format = compress ? 0 : GL_RGBA;
+	header->type = compress ? 0 : GL_UNSIGNED_BYTE;
+	header->levelOffset = (uint32_t)levelOffset;
+
+	TextureCacheLevel* levels = (TextureCacheLevel*)(memory.data() + levelOffset);
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		levels[i].offset = offsets[i];
+		levels[i].width = MipGenerator::levelSize(width, i);
+		levels[i].height = MipGenerator::levelSize(height, i);
+		levels[i].size = (uint32_t)sizes[i];
+		levels[i].padding = 0;
+
+		if (compress)
+			BlockEncoder::encode(blockFormat, chain.data() + chainOffsets[i], levels[i].width, levels[i].height, memory.data() + offsets[i]);
+		else
+			memcpy(memory.data() + offsets[i], chain.data() + chainOffsets[i], sizes[i]);
+	}
+
+	image.bytes = memory.data();
+	image.length = memory.size();
+
+	// Best effort, as with the mesh cache
+	std::ofstream out(cachePath(sourcePath), std::ios::binary | std::ios::trunc);
+	if (out)
+		out.write((const char*)memory.data(), memory.size());
+	if (!out)
+		std::cout << "TextureCache: could not write " << cachePath(sourcePath) << std::endl;
+
+	return true;
+}
+
+bool TextureCache::load(const std::string& sourcePath, uint32_t flags, TextureCacheImage& image) {
+
+	MappedFile source;
+	if (!source.open(sourcePath)) {
+		std::cout << "TextureCache: cannot open " << sourcePath << std::endl;
+		return false;
+	}
+
+	uint64_t sourceHash = fnv1a64(source.data(), source.size());
+
+	if (image.file.open(cachePath(sourcePath))) {
+		image.bytes = image.file.data();
+		image.length = image.file.size();
+
+		if (validate(image, sourceHash, flags))
+			return true;
+
+		image.file.close();
+		image.bytes = nullptr;
+		image.length = 0;
+	}
+
+	// The source is already mapped for hashing, so decode straight from it
+	return build(sourcePath, source.data(), source.size(), sourceHash, flags, image);
+}
@@ -0,0 +1,108 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of a .texcache file:
+//   TextureCacheHeader
+//   TextureCacheLevel[levelCount]
+//   level data (16-byte aligned, largest level first, back to back)
+// Level data is already in the format glTexImage2D takes, so a warm load is
+// a mapping and an upload with no decode or mip generation.
+struct TextureCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t flags;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t internalFormat;	// GL internal format of every level
+	uint32_t format;			// GL pixel format and type for glTexImage2D; 0 if block compressed
+	uint32_t type;
+	uint32_t levelOffset;
+};
+
+struct TextureCacheLevel {
+	uint64_t offset;
+	uint32_t size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t padding;
+};
+
+// A texture cache file held in memory, mapped or freshly built
+class TextureCacheImage {
+
+private:
+
+	MappedFile file;
+	std::vector<unsigned char> memory;
+	const unsigned char* bytes;
+	size_t length;
+
+	friend class TextureCache;
+
+public:
+
+	TextureCacheImage() : bytes(nullptr), length(0) {}
+
+	TextureCacheImage(const TextureCacheImage&) = delete;
+	TextureCacheImage& operator=(const TextureCacheImage&) = delete;
+
+	bool isMapped() const {
+		return file.isOpen();
+	}
+
+	const TextureCacheHeader& header() const {
+		return *(const TextureCacheHeader*)bytes;
+	}
+	const TextureCacheLevel& level(uint32_t index) const {
+		return ((const TextureCacheLevel*)(bytes + header().levelOffset))[index];
+	}
+	const unsigned char* pixels(uint32_t levelIndex) const {
+		return bytes + level(levelIndex).offset;
+	}
+};
+
+// Versioned texture cache written next to each image (<image>.texcache),
+// holding the full mip chain as RGBA8 or, on request, BCn blocks. Keyed by a
+// hash of the source file and the load flags; a mismatch decodes the source
+// again and rewrites it.
+class TextureCache {
+
+private:
+
+	// Bytes a width x height level takes in the header's format, 0 if the format is not one build() writes
+	static size_t levelSize(const TextureCacheHeader& header, uint32_t width, uint32_t height);
+
+	static bool validate(const TextureCacheImage& image, uint64_t sourceHash, uint32_t flags);
+	static bool build(const std::string& sourcePath, const unsigned char* source, size_t sourceSize, uint64_t sourceHash, uint32_t flags, TextureCacheImage& image);
+
+public:
+
+	// Bump whenever the file layout or the mip filter changes
+	static const uint32_t VERSION = 3;
+
+	// Colour data: mips are filtered in linear light
+	static const uint32_t SRGB = 1 << 0;
+
+	// Store block compressed: BC1 if fully opaque, BC3 otherwise
+	static const uint32_t COMPRESS = 1 << 1;
+
+	// Tangent-space normals in RG; compresses to BC5 instead
+	static const uint32_t NORMAL_MAP = 1 << 2;
+
+	static bool isCompressed(const TextureCacheHeader& header) {
+		return header.format == 0;
+	}
+
+	static std::string cachePath(const std::string& sourcePath);
+
+	static bool load(const std::string& sourcePath, uint32_t flags, TextureCacheImage& image);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "UniformTable.h"
+#include <algorithm>
+
+UniformTable::UniformTable() : program(0) {}
+
+UniformTable::UniformTable(GLuint programIn) : program(0) {
+	reflect(programIn);
+}
+
+void UniformTable::reflect(GLuint programIn) {
+
+	program = programIn;
+	entries.clear();
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+
+	for (GLint i = 0; i < uniformCount; i++) {
+
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(program, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), nameLength);
+
+		// Block members have no location and are fed through buffers instead
+		GLint location = glGetUniformLocation(program, name.c_str());
+		if (location < 0)
+			continue;
+
+		// Arrays are reported as "name[0]" with a size; register every element
+		// so "Light[3]" style names resolve without a driver round-trip later
+		size_t bracket = name.rfind("[0]");
+		if (bracket != std::string::npos && bracket + 3 == name.size()) {
+
+			std::string baseName = name.substr(0, bracket);
+			entries.push_back({ baseName, location, type });
+
+			for (GLint element = 0; element < arraySize; element++) {
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				entries.push_back({ elementName, glGetUniformLocation(program, elementName.c_str()), type });
+			}
+		}
+		else {
+			entries.push_back({ name, location, type });
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.name < b.name;
+	});
+}
+
+const UniformTable::Entry* UniformTable::find(const std::string& name) const {
+
+	auto it = std::lower_bound(entries.begin(), entries.end(), name, [](const Entry& entry, const std::string& key) {
+		return entry.name < key;
+	});
+
+	if (it == entries.end() || it->name != name)
+		return nullptr;
+
+	return &(*it);
+}
+
+GLint UniformTable::getLocation(const std::string& name) const {
+	const Entry* entry = find(name);
+	return entry ? entry->location : -1;
+}
+
+void UniformTable::bindBlock(const std::string& blockName, GLuint binding) const {
+	GLuint blockIndex = glGetUniformBlockIndex(program, blockName.c_str());
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, blockIndex, binding);
+}
+
+bool UniformTable::typeMatches(GLenum glType, GLenum expected) {
+
+	if (glType == expected)
+		return true;
+
+	// Samplers and bools are set through the integer entry points
+	if (expected == GL_INT) {
+		switch (glType) {
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY:
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,121 @@
+#ifndef UNIFORMTABLE_H
+#define UNIFORMTABLE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Typed handle to a uniform location resolved at link time.
+// Like glUniform*, setting an inactive uniform (location -1) does nothing.
+// set() writes to the currently bound program.
+template <typename T>
+class Uniform {
+
+private:
+
+	GLint location;
+
+public:
+
+	Uniform() : location(-1) {}
+	explicit Uniform(GLint locationIn) : location(locationIn) {}
+
+	void set(const T& value) const;
+
+	bool isActive() const {
+		return location >= 0;
+	}
+	GLint getLocation() const {
+		return location;
+	}
+};
+
+template <> inline void Uniform<GLint>::set(const GLint& value) const {
+	glUniform1i(location, value);
+}
+template <> inline void Uniform<GLuint>::set(const GLuint& value) const {
+	glUniform1ui(location, value);
+}
+template <> inline void Uniform<GLfloat>::set(const GLfloat& value) const {
+	glUniform1f(location, value);
+}
+template <> inline void Uniform<glm::vec3>::set(const glm::vec3& value) const {
+	glUniform3fv(location, 1, glm::value_ptr(value));
+}
+template <> inline void Uniform<glm::vec4>::set(const glm::vec4& value) const {
+	glUniform4fv(location, 1, glm::value_ptr(value));
+}
+template <> inline void Uniform<glm::mat3>::set(const glm::mat3& value) const {
+	glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+template <> inline void Uniform<glm::mat4>::set(const glm::mat4& value) const {
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+// Flat table of every active uniform in a linked program, built once with
+// glGetActiveUniform. Name lookups happen here at load time only; the render
+// loop keeps the returned Uniform<T> handles and never touches a string.
+class UniformTable {
+
+public:
+
+	struct Entry {
+		std::string name;
+		GLint location;
+		GLenum type;
+	};
+
+private:
+
+	GLuint program;
+	std::vector<Entry> entries;	// Sorted by name
+
+	const Entry* find(const std::string& name) const;
+	static bool typeMatches(GLenum glType, GLenum expected);
+
+	template <typename T> static GLenum glTypeOf();
+
+public:
+
+	UniformTable();
+	explicit UniformTable(GLuint programIn);
+
+	void reflect(GLuint programIn);
+
+	GLint getLocation(const std::string& name) const;
+
+	// Points a uniform block at a buffer binding, for GLSL versions without layout(binding)
+	void bindBlock(const std::string& blockName, GLuint binding) const;
+
+	template <typename T>
+	Uniform<T> get(const std::string& name) const {
+		const Entry* entry = find(name);
+		if (entry == nullptr)
+			return Uniform<T>();
+
+		if (!typeMatches(entry->type, glTypeOf<T>()))
+			std::cout << "UniformTable: type mismatch for uniform '" << name << "'" << std::endl;
+
+		return Uniform<T>(entry->location);
+	}
+
+	GLuint getProgram() const {
+		return program;
+	}
+	const std::vector<Entry>& getEntries() const {
+		return entries;
+	}
+};
+
+template <> inline GLenum UniformTable::glTypeOf<GLint>() { return GL_INT; }
+template <> inline GLenum UniformTable::glTypeOf<GLuint>() { return GL_UNSIGNED_INT; }
+template <> inline GLenum UniformTable::glTypeOf<GLfloat>() { return GL_FLOAT; }
+template <> inline GLenum UniformTable::glTypeOf<glm::vec3>() { return GL_FLOAT_VEC3; }
+template <> inline GLenum UniformTable::glTypeOf<glm::vec4>() { return GL_FLOAT_VEC4; }
+template <> inline GLenum UniformTable::glTypeOf<glm::mat3>() { return GL_FLOAT_MAT3; }
+template <> inline GLenum UniformTable::glTypeOf<glm::mat4>() { return GL_FLOAT_MAT4; }
+
+#endif
@@ -0,0 +1,168 @@
+#include "VertexQuantizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+const float VertexQuantizer::POSITION_TOLERANCE = 1.0e-4f;
+const float VertexQuantizer::NORMAL_TOLERANCE = 0.1f;
+const float VertexQuantizer::TEXCOORD_TOLERANCE = 1.0f / 1024.0f;
+
+bool VertexQuantizer::pack(const std::vector<MeshVertex>& vertices, std::vector<PackedVertex>& packed, glm::vec3& scale, glm::vec3& offset, Error& error) {
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (const MeshVertex& vertex : vertices) {
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	if (vertices.empty())
+		boundsMin = boundsMax = glm::vec3(0.0f);
+
+	offset = boundsMin;
+	scale = boundsMax - boundsMin;
+
+	error.position = 0.0f;
+	error.normal = 0.0f;
+	error.texCoord = 0.0f;
+
+	packed.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+
+		const MeshVertex& source = vertices[i];
+		PackedVertex& vertex = packed[i];
+
+		for (int axis = 0; axis < 3; axis++) {
+			float unorm = scale[axis] > 0.0f ? (source.position[axis] - offset[axis]) / scale[axis] : 0.0f;
+			vertex.position[axis] = (uint16_t)std::lround(std::min(std::max(unorm, 0.0f), 1.0f) * 65535.0f);
+		}
+		vertex.position[3] = 0;
+
+		encodeOctahedral(source.normal, vertex.normal);
+		vertex.texCoord[0] = toHalf(source.texCoord.x);
+		vertex.texCoord[1] = toHalf(source.texCoord.y);
+
+		error.position = std::max(error.position, glm::length(decodePosition(vertex, scale, offset) - source.position));
+
+		// Meshes imported without normals carry zero vectors; there is nothing to lose
+		float length = glm::length(source.normal);
+		if (length > 0.0f) {
+			float cosine = glm::dot(source.normal / length, decodeOctahedral(vertex.normal));
+			error.normal = std::max(error.normal, glm::degrees(std::acos(std::min(std::max(cosine, -1.0f), 1.0f))));
+		}
+
+		error.texCoord = std::max(error.texCoord, std::fabs(fromHalf(vertex.texCoord[0]) - source.texCoord.x));
+		error.texCoord = std::max(error.texCoord, std::fabs(fromHalf(vertex.texCoord[1]) - source.texCoord.y));
+	}
+
+	// Written so that NaN (from a half overflow) fails too
+	return error.position <= POSITION_TOLERANCE * glm::length(scale) &&
+		error.normal <= NORMAL_TOLERANCE &&
+		error.texCoord <= TEXCOORD_TOLERANCE;
+}
+
+glm::vec3 VertexQuantizer::decodePosition(const PackedVertex& vertex, const glm::vec3& scale, const glm::vec3& offset) {
+	return offset + glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) * (1.0f / 65535.0f) * scale;
+}
+
+void VertexQuantizer::encodeOctahedral(const glm::vec3& normal, int16_t encoded[2]) {
+
+	float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (sum == 0.0f) {
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	float u = normal.x / sum;
+	float v = normal.y / sum;
+
+	// Fold the lower hemisphere over the diagonals
+	if (normal.z < 0.0f) {
+		float foldedU = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		float foldedV = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = foldedU;
+		v = foldedV;
+	}
+
+	encoded[0] = (int16_t)std::lround(std::min(std::max(u, -1.0f), 1.0f) * 32767.0f);
+	encoded[1] = (int16_t)std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+}
+
+glm::vec3 VertexQuantizer::decodeOctahedral(const int16_t encoded[2]) {
+
+	// snorm16 as GL normalises it
+	float u = std::max(encoded[0] / 32767.0f, -1.0f);
+	float v = std::max(encoded[1] / 32767.0f, -1.0f);
+
+	glm::vec3 normal(u, v, 1.0f - std::fabs(u) - std::fabs(v));
+	if (normal.z < 0.0f) {
+		normal.x = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		normal.y = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+	}
+	return glm::normalize(normal);
+}
+
+uint16_t VertexQuantizer::toHalf(float value) {
+
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	// Infinity and NaN
+	if (((bits >> 23) & 0xff) == 0xff)
+		return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+
+	// Too large: infinity
+	if (exponent >= 31)
+		return sign | 0x7c00;
+
+	// Subnormal or zero
+	if (exponent <= 0) {
+		if (exponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint16_t half = (uint16_t)(mantissa >> shift);
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+		return sign | half;
+	}
+
+	// A carry out of the mantissa rolls into the exponent, which is still correct
+	uint16_t half = (uint16_t)(sign | (exponent << 10) | (mantissa >> 13));
+	if (mantissa & 0x1000)
+		half++;
+	return half;
+}
+
+float VertexQuantizer::fromHalf(uint16_t value) {
+
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+	uint32_t bits;
+
+	if (exponent == 0) {
+		if (mantissa == 0) {
+			bits = sign;
+		} else {
+			// Subnormal: normalise into a float exponent
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+	} else if (exponent == 31) {
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	} else {
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
@@ -0,0 +1,42 @@
+#ifndef VERTEXQUANTIZER_H
+#define VERTEXQUANTIZER_H
+
+#include "MeshCache.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Converts MeshVertex data to PackedVertex (half the size) and measures what
+// the conversion costs. The decode here mirrors Basic_shader.vert.
+class VertexQuantizer {
+
+public:
+
+	// Largest error accepted for a mesh to be stored packed
+	static const float POSITION_TOLERANCE;	// Fraction of the mesh's AABB diagonal
+	static const float NORMAL_TOLERANCE;	// Degrees
+	static const float TEXCOORD_TOLERANCE;	// UV units
+
+	// Worst error over a mesh
+	struct Error {
+		float position;	// Model units
+		float normal;	// Degrees
+		float texCoord;	// UV units
+	};
+
+	// Packs every vertex and reports the error. Returns false if any tolerance
+	// is exceeded, in which case the mesh should stay as MeshVertex.
+	static bool pack(const std::vector<MeshVertex>& vertices, std::vector<PackedVertex>& packed, glm::vec3& scale, glm::vec3& offset, Error& error);
+
+	static glm::vec3 decodePosition(const PackedVertex& vertex, const glm::vec3& scale, const glm::vec3& offset);
+
+	// Octahedral map of a unit vector to the [-1, 1] square, stored as snorm16
+	static void encodeOctahedral(const glm::vec3& normal, int16_t encoded[2]);
+	static glm::vec3 decodeOctahedral(const int16_t encoded[2]);
+
+	// IEEE 754 binary16, rounding to nearest
+	static uint16_t toHalf(float value);
+	static float fromHalf(uint16_t value);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+WorkerPool::WorkerPool(unsigned threadCount) : busy(0), stopping(false) {
+
+	if (threadCount == 0) {
+		unsigned hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	for (unsigned i = 0; i < threadCount; i++)
+		threads.push_back(std::thread(&WorkerPool::workerMain, this));
+}
+
+WorkerPool::~WorkerPool() {
+	shutdown();
+}
+
+void WorkerPool::workerMain() {
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+
+		wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+		if (stopping)
+			return;
+
+		std::function<void()> job = std::move(jobs.front());
+		jobs.pop_front();
+		busy++;
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		busy--;
+		if (busy == 0 && jobs.empty())
+			idle.notify_all();
+	}
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping)
+			return;
+		jobs.push_back(std::move(job));
+	}
+	wake.notify_one();
+}
+
+void WorkerPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return stopping || (busy == 0 && jobs.empty()); });
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+
+	if (count == 0)
+		return;
+
+	// Shared with the helper jobs, which may only get to run after the range
+	// is exhausted and this call has returned
+	struct Range {
+		std::function<void(size_t)> body;
+		std::atomic<size_t> next;
+		size_t count;
+		size_t finished;
+		std::mutex mutex;
+		std::condition_variable done;
+
+		void run() {
+			size_t ran = 0;
+			for (size_t i = next++; i < count; i = next++) {
+				body(i);
+				ran++;
+			}
+			if (ran == 0)
+				return;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			finished += ran;
+			if (finished == count)
+				done.notify_all();
+		}
+	};
+
+	std::shared_ptr<Range> range = std::make_shared<Range>();
+	range->body = body;
+	range->next = 0;
+	range->count = count;
+	range->finished = 0;
+
+	size_t helpers = std::min(count - 1, threads.size());
+	for (size_t i = 0; i < helpers; i++)
+		submit([range] { range->run(); });
+
+	range->run();
+
+	std::unique_lock<std::mutex> lock(range->mutex);
+	range->done.wait(lock, [&range] { return range->finished == range->count; });
+}
+
+WorkerPool& WorkerPool::shared() {
+	static WorkerPool pool;
+	return pool;
+}
+
+void WorkerPool::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping)
+			return;
+		stopping = true;
+		jobs.clear();
+	}
+	wake.notify_all();
+	idle.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+}
@@ -0,0 +1,58 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of background threads pulling jobs from a shared FIFO queue.
+// Jobs must not touch GL; the context is only current on the main thread.
+class WorkerPool {
+
+private:
+
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	unsigned busy;
+	bool stopping;
+
+	void workerMain();
+
+public:
+
+	// 0 picks one thread per hardware thread, minus the main thread
+	explicit WorkerPool(unsigned threadCount = 0);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void submit(std::function<void()> job);
+
+	// Blocks until the queue is empty and no job is running
+	void wait();
+
+	// Runs body(i) for every i in [0, count), spread over the pool and the
+	// calling thread, and returns once all have finished. The caller works
+	// through the range too, so this is safe to call from inside a job.
+	void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+	// Drops queued jobs, lets running ones finish and joins every thread
+	void shutdown();
+
+	// Process-wide pool for data-parallel work such as texture encoding
+	static WorkerPool& shared();
+
+	unsigned getThreadCount() const {
+		return (unsigned)threads.size();
+	}
+};
+
+#endif